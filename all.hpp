@@ -12,5 +12,12 @@
 
 #include "amsg.hpp"
 #include "zerocopy.hpp"
+#include "parallel.hpp"
+#include "input.hpp"
+#include "push.hpp"
+#include "record.hpp"
+#include "record_log.hpp"
+#include "group_writer.hpp"
+#include "arena.hpp"
 
 #endif
@@ -11,22 +11,37 @@
 #define AMSG_AMSG_HPP
 
 #include <stdint.h>
+#include <cstring>
 #include <string>
 #include <deque>
 #include <list>
 #include <vector>
 #include <map>
+#include <set>
 #include <limits>
 #include <type_traits>
 #include <array>
 #include <forward_list>
+#include <iterator>
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+# define AMSG_HAS_STRING_VIEW
+# include <string_view>
+#endif
 
 #include <boost/preprocessor/seq/for_each.hpp>
 #include <boost/preprocessor/seq/seq.hpp>
+#include <boost/preprocessor/seq/size.hpp>
 #include <boost/preprocessor/stringize.hpp>
 #include <boost/preprocessor/tuple/elem.hpp>
 #include <boost/preprocessor/facilities/empty.hpp>
+#include <boost/array.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
 
 #ifndef AMSG_INLINE
 # ifdef _MSC_VER
@@ -39,6 +54,22 @@
 # endif
 #endif
 
+/// define AMSG_NO_ERROR_PATH to drop field path recording of read/write errors.
+#ifdef AMSG_NO_ERROR_PATH
+# define AMSG_ERROR_MEMBER(store_data, name)
+# define AMSG_ERROR_INDEX(store_data, index)
+# define AMSG_ERROR_PATH(store_data, inner)
+#else
+# define AMSG_ERROR_MEMBER(store_data, name) (store_data).append_error_member(name)
+# define AMSG_ERROR_INDEX(store_data, index) (store_data).append_error_index(index)
+# define AMSG_ERROR_PATH(store_data, inner) (store_data).append_error_path((inner).error_path())
+#endif
+
+#ifdef _WIN32
+#else
+#include <arpa/inet.h>  /* __BYTE_ORDER */
+#endif
+
 namespace amsg
 {
 #if _MSC_VER > 1300
@@ -82,11 +113,6 @@ namespace amsg
 
   //define endian check macro
 
-#ifdef _WIN32
-#else
-#include <arpa/inet.h>  /* __BYTE_ORDER */
-#endif
-
 #	if !defined(__LITTLE_ENDIAN__) && !defined(__BIG_ENDIAN__)
 #		if __BYTE_ORDER == __LITTLE_ENDIAN
 #			define __LITTLE_ENDIAN__
@@ -209,6 +235,46 @@ namespace amsg
     return u.fv;
   }
 
+  /// value must not be 0.
+  AMSG_INLINE int count_trailing_zeros(uint32_t value)
+  {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return (int)index;
+#elif defined(__GNUC__)
+    return __builtin_ctz(value);
+#else
+    int count = 0;
+    while ((value & 1) == 0)
+    {
+      value >>= 1;
+      ++count;
+    }
+    return count;
+#endif
+  }
+
+  /// value must not be 0.
+  AMSG_INLINE int count_leading_zeros(uint64_t value)
+  {
+#if defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return 63 - (int)index;
+#elif defined(__GNUC__)
+    return __builtin_clzll(value);
+#else
+    int count = 0;
+    while ((value & 0x8000000000000000ULL) == 0)
+    {
+      value <<= 1;
+      ++count;
+    }
+    return count;
+#endif
+  }
+
   static size_t to_str(const uint32_t& Value, char * resultbuffer, size_t len)
   {
     uint32_t temp = Value;
@@ -224,7 +290,7 @@ namespace amsg
       temp = temp / 10;
     }
     ++pos;
-    memmove(resultbuffer, resultbuffer + pos, (len - pos));
+    ::std::memmove(resultbuffer, resultbuffer + pos, (len - pos));
     return len - pos;
   }
 
@@ -235,7 +301,134 @@ namespace amsg
     value_too_large_to_integer_number,
     sequence_length_overflow,
     stream_buffer_overflow,
-    number_of_element_not_macth
+    number_of_element_not_macth,
+    decode_limit_exceeded
+  };
+
+  /// decode budget of a store, 0 is unlimited. bytes counts string bytes and container
+  /// element bytes (sizeof), elements counts container elements, depth nested AMSG structs.
+  struct decode_limits
+  {
+    uint64_t max_bytes;
+    uint64_t max_elements;
+    uint32_t max_depth;
+
+    decode_limits(uint64_t bytes = 0, uint64_t elements = 0, uint32_t depth = 0)
+      : max_bytes(bytes)
+      , max_elements(elements)
+      , max_depth(depth)
+    {
+    }
+  };
+
+  /// field path of an error, recorded from failed field outward in fixed room without allocation,
+  /// rendered to text only by append_to. deeper entries than capacity are dropped.
+  class error_path
+  {
+  public:
+    enum { capacity = 8 };
+
+    error_path()
+      : m_size(0)
+      , m_dropped(false)
+    {
+    }
+
+    /// text must outlive the path, string literal usually.
+    AMSG_INLINE void push_text(const char * text)
+    {
+      push(text, 0, text_entry);
+    }
+
+    AMSG_INLINE void push_member(const char * name)
+    {
+      push(name, 0, member_entry);
+    }
+
+    AMSG_INLINE void push_index(uint32_t index)
+    {
+      push(0, index, index_entry);
+    }
+
+    /// entries of other (a path inside field where this one goes on) then these.
+    AMSG_INLINE void push_path(const error_path& other)
+    {
+      for (uint32_t i = 0; i < other.m_size; ++i)
+      {
+        push(other.m_entries[i].text, other.m_entries[i].index, other.m_entries[i].kind);
+      }
+      m_dropped = m_dropped || other.m_dropped;
+    }
+
+    AMSG_INLINE uint32_t size() const
+    {
+      return m_size;
+    }
+
+    AMSG_INLINE void clear()
+    {
+      m_size = 0;
+      m_dropped = false;
+    }
+
+    template<typename string_ty>
+    void append_to(string_ty& str) const
+    {
+      for (uint32_t i = 0; i < m_size; ++i)
+      {
+        const entry& e = m_entries[i];
+        switch (e.kind)
+        {
+        case member_entry:
+          str.append(".");
+          str.append(e.text);
+          break;
+        case index_entry:
+        {
+          char buffer[16];
+          to_str(e.index, buffer, 16);
+          str.append("[");
+          str.append(buffer);
+          str.append("]");
+          break;
+        }
+        default:
+          str.append(e.text);
+          break;
+        }
+      }
+      if (m_dropped)
+      {
+        str.append("...");
+      }
+    }
+
+  private:
+    enum { text_entry, member_entry, index_entry };
+
+    struct entry
+    {
+      const char * text;
+      uint32_t index;
+      uint32_t kind;
+    };
+
+    AMSG_INLINE void push(const char * text, uint32_t index, uint32_t kind)
+    {
+      if (m_size == capacity)
+      {
+        m_dropped = true;
+        return;
+      }
+      entry& e = m_entries[m_size++];
+      e.text = text;
+      e.index = index;
+      e.kind = kind;
+    }
+
+    entry m_entries[capacity];
+    uint32_t m_size;
+    bool m_dropped;
   };
 
   struct basic_store
@@ -243,6 +436,12 @@ namespace amsg
 
     basic_store()
       : m_error_code(success)
+      , m_max_bytes((::std::numeric_limits<uint64_t>::max)())
+      , m_max_elements((::std::numeric_limits<uint64_t>::max)())
+      , m_max_depth((::std::numeric_limits<uint32_t>::max)())
+      , m_decoded_bytes(0)
+      , m_decoded_elements(0)
+      , m_depth(0)
     {
 
     }
@@ -273,6 +472,8 @@ namespace amsg
         return "stream buffer overflow";
       case number_of_element_not_macth:
         return "number of element not macth";
+      case decode_limit_exceeded:
+        return "decode limit exceeded";
       default:
         break;
       }
@@ -287,9 +488,115 @@ namespace amsg
     AMSG_INLINE void clear()
     {
       m_error_code = success;
+#ifndef AMSG_NO_ERROR_PATH
+      m_error_path.clear();
+#endif
+      reset_decode_budget();
+    }
+
+    /// limits apply to everything decoded until clear, reset_decode_budget or a new read region.
+    AMSG_INLINE void set_decode_limits(const decode_limits& limits)
+    {
+      m_max_bytes = limits.max_bytes ? limits.max_bytes : (::std::numeric_limits<uint64_t>::max)();
+      m_max_elements = limits.max_elements ? limits.max_elements : (::std::numeric_limits<uint64_t>::max)();
+      m_max_depth = limits.max_depth ? limits.max_depth : (::std::numeric_limits<uint32_t>::max)();
+      reset_decode_budget();
+    }
+
+    AMSG_INLINE void reset_decode_budget()
+    {
+      m_decoded_bytes = 0;
+      m_decoded_elements = 0;
+      m_depth = 0;
+    }
+
+    AMSG_INLINE bool decode_limited() const
+    {
+      return m_max_bytes != (::std::numeric_limits<uint64_t>::max)() ||
+        m_max_elements != (::std::numeric_limits<uint64_t>::max)() ||
+        m_max_depth != (::std::numeric_limits<uint32_t>::max)();
+    }
+
+    AMSG_INLINE uint64_t decoded_bytes() const
+    {
+      return m_decoded_bytes;
+    }
+
+    AMSG_INLINE uint64_t decoded_elements() const
+    {
+      return m_decoded_elements;
+    }
+
+    /// count elements and bytes about to be allocated, false and decode_limit_exceeded if over budget.
+    AMSG_INLINE bool charge_decode(uint64_t elements, uint64_t bytes)
+    {
+      m_decoded_elements += elements;
+      m_decoded_bytes += bytes;
+      if (m_decoded_elements > m_max_elements || m_decoded_bytes > m_max_bytes)
+      {
+        m_error_code = decode_limit_exceeded;
+        return false;
+      }
+      return true;
+    }
+
+    AMSG_INLINE bool enter_struct()
+    {
+      if (++m_depth > m_max_depth)
+      {
+        m_error_code = decode_limit_exceeded;
+        return false;
+      }
+      return true;
+    }
+
+    AMSG_INLINE void leave_struct()
+    {
+      --m_depth;
+    }
+
+#ifndef AMSG_NO_ERROR_PATH
+    AMSG_INLINE const ::amsg::error_path& error_path() const
+    {
+      return m_error_path;
+    }
+
+    AMSG_INLINE void append_error_member(const char * name)
+    {
+      m_error_path.push_member(name);
+    }
+
+    AMSG_INLINE void append_error_index(uint32_t index)
+    {
+      m_error_path.push_index(index);
+    }
+
+    AMSG_INLINE void append_error_path(const ::amsg::error_path& path)
+    {
+      m_error_path.push_path(path);
+    }
+
+    /// info must outlive the store, string literal usually.
+    AMSG_INLINE void append_debug_info(const char * info)
+    {
+      m_error_path.push_text(info);
+    }
+#else
+    AMSG_INLINE void append_debug_info(const char *)
+    {
     }
+#endif
 
     error_code_t	m_error_code;
+    uint64_t m_max_bytes;
+    uint64_t m_max_elements;
+    uint32_t m_max_depth;
+    uint64_t m_decoded_bytes;
+    uint64_t m_decoded_elements;
+    uint32_t m_depth;
+#ifndef AMSG_NO_ERROR_PATH
+    ::amsg::error_path m_error_path;
+#endif
   };
 
   template< typename stream_ty, typename error_string_ty = ::std::string >
@@ -302,11 +609,14 @@ namespace amsg
     {
     }
 
-    AMSG_INLINE const error_string_ty& info() const { return this->m_error_info; }
-
-    AMSG_INLINE void append_debug_info(const char * info)
+    /// error field path as text, built when asked.
+    AMSG_INLINE const error_string_ty& info() const
     {
-      this->m_error_info.append(info);
+      this->m_error_info.clear();
+#ifndef AMSG_NO_ERROR_PATH
+      this->error_path().append_to(this->m_error_info);
+#endif
+      return this->m_error_info;
     }
 
     AMSG_INLINE bool bad()const { return this->m_stream.bad(); }
@@ -345,7 +655,7 @@ namespace amsg
 
   private:
     stream_ty&		m_stream;
-    error_string_ty		m_error_info;
+    mutable error_string_ty		m_error_info;
   };
 
   template<typename stream_ty>
@@ -354,6 +664,27 @@ namespace amsg
     return store<stream_ty>(stream);
   }
 
+  /// write cursor over room checked once by unchecked_write_begin, no bound check per write.
+  struct unchecked_write_buffer : public basic_store
+  {
+    unsigned char * m_write_ptr;
+
+    explicit unchecked_write_buffer(unsigned char * ptr)
+      : basic_store()
+      , m_write_ptr(ptr)
+    {
+    }
+
+    AMSG_INLINE bool bad() const { return false; }
+
+    AMSG_INLINE ::std::size_t write(const char * buffer, ::std::size_t len)
+    {
+      ::std::memcpy(this->m_write_ptr, buffer, len);
+      this->m_write_ptr += len;
+      return len;
+    }
+  };
+
   enum
   {
     const_interger_byte_msak = 0x3f,
@@ -364,6 +695,52 @@ namespace amsg
     const_store_negative_integer_byte_mask = 0x80 + const_negative_bit_value - 2
   };
 
+  /// value bytes of a magnitude bigger than const_tag_as_value, 1 to 8.
+  AMSG_INLINE int integer_value_bytes(uint64_t magnitude)
+  {
+    return (71 - count_leading_zeros(magnitude)) >> 3;
+  }
+
+  template<typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<::std::is_signed<value_type>::value, uint64_t>::type
+    integer_magnitude(const value_type& value, uint8_t& negative_bit)
+  {
+    if (value < 0)
+    {
+      negative_bit = const_negative_bit_value;
+      return 0 - (uint64_t)(int64_t)value;
+    }
+    return (uint64_t)value;
+  }
+
+  template<typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<::std::is_unsigned<value_type>::value, uint64_t>::type
+    integer_magnitude(const value_type& value, uint8_t&)
+  {
+    return (uint64_t)value;
+  }
+
+  /// write tag and value bytes at ptr with one unaligned 8 bytes store, ptr must have 9 bytes room.
+  /// return the end of encoded bytes.
+  template<typename value_type>
+  AMSG_INLINE uint8_t * encode_integer(uint8_t * ptr, const value_type& value)
+  {
+    uint8_t negative_bit = 0;
+    uint64_t temp = integer_magnitude(value, negative_bit);
+    if (negative_bit == 0 && temp < const_tag_as_type)
+    {
+      *ptr = (uint8_t)temp;
+      return ptr + 1;
+    }
+    int bytes = integer_value_bytes(temp);
+    *ptr = (uint8_t)(const_tag_as_type + negative_bit + bytes - 1);
+    temp = host_to_little_endian64(temp);
+    ::std::memcpy(ptr + 1, &temp, 8);
+    return ptr + 1 + bytes;
+  }
+
   template <typename value_type>
   struct sfix_op
   {
@@ -417,7 +794,7 @@ namespace amsg
   struct smax
   {
     uint32_t size;
-    smax(uint32_t max = 0)
+    constexpr smax(uint32_t max = 0)
       :size(max)
     {}
   };
@@ -429,12 +806,135 @@ namespace amsg
     return valid;
   }
 
+  template <typename value_type>
+  struct sidx_valid
+  {
+    uint32_t stride;
+    value_type & val;
+    sidx_valid(uint32_t step, value_type& value)
+      :stride(step > 0 ? step : 1), val(value)
+    {}
+    sidx_valid(const sidx_valid& rv)
+      :stride(rv.stride), val(rv.val)
+    {}
+  };
+
+  /// indexed vector: element offset table every stride elements, see sidx_valid overloads.
+  struct sidx
+  {
+    uint32_t stride;
+    constexpr sidx(uint32_t step = 1)
+      :stride(step)
+    {}
+  };
+
+  template<typename ty>
+  AMSG_INLINE sidx_valid<ty> operator & (ty& value, const sidx& si)
+  {
+    sidx_valid<ty> valid(si.stride, value);
+    return valid;
+  }
+
+  template<typename type>
+  struct is_sidx : public ::std::false_type{};
+
+  template<typename type>
+  struct is_sidx<sidx_valid<type> > : public ::std::true_type{};
+
   template<typename value_type>
   AMSG_INLINE bool can_skip(const value_type&)
   {
     return false;
   }
 
+  /// write bytes of object being written (string data, raw sequence), stores can reference them instead of copy.
+  template<typename store_ty>
+  AMSG_INLINE ::std::size_t write_raw(store_ty& store_data, const char * buffer, ::std::size_t len)
+  {
+    return store_data.write(buffer, len);
+  }
+
+  /// single pass write, stores which can patch bytes already written override these.
+  /// AMSG struct then reserves its length prefix and patches it after writing members,
+  /// instead of calling size_of before write.
+  template<typename store_ty>
+  AMSG_INLINE bool single_pass(const store_ty&)
+  {
+    return false;
+  }
+
+  template<typename store_ty>
+  AMSG_INLINE ::std::size_t begin_length_prefix(store_ty&)
+  {
+    return 0;
+  }
+
+  template<typename store_ty>
+  AMSG_INLINE void end_length_prefix(store_ty&, ::std::size_t)
+  {
+  }
+
+  /// stores with a contiguous write region override these, AMSG struct checks its size once
+  /// and writes members by unchecked_write_buffer at returned room (size + 8 bytes for
+  /// encode_integer), then commits written bytes.
+  template<typename store_ty>
+  AMSG_INLINE unsigned char * unchecked_write_begin(store_ty&, ::std::size_t)
+  {
+    return 0;
+  }
+
+  template<typename store_ty>
+  AMSG_INLINE void unchecked_write_end(store_ty&, ::std::size_t)
+  {
+  }
+
+  /// specialized by AMSG macro, let templates find struct's size_of declared after them.
+  template<typename value_type>
+  struct struct_traits : public ::std::false_type{};
+
+  template<typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<struct_traits<value_type>::value, uint32_t>::type
+    size_of(const value_type& value)
+  {
+    return struct_traits<value_type>::size_of(value);
+  }
+
+  /// fewest bytes a value is encoded in, AMSG struct has length and tag at least.
+  template<typename value_type>
+  constexpr ::std::size_t min_size_of()
+  {
+    return ::std::is_same<value_type, float>::value ? sizeof(float)
+      : ::std::is_same<value_type, double>::value ? sizeof(double)
+      : struct_traits<value_type>::value ? 2 : 1;
+  }
+
+  /// bytes left to read, stores which know their input size override it.
+  template<typename store_ty>
+  AMSG_INLINE ::std::size_t read_remain(const store_ty&)
+  {
+    return (::std::numeric_limits< ::std::size_t>::max)();
+  }
+
+  /// an AMSG struct of len_tag bytes starting at offset is about to be decoded,
+  /// buffered stores may bring it in at once.
+  template<typename store_ty>
+  AMSG_INLINE void read_ahead(store_ty&, ::std::size_t, uint32_t)
+  {
+  }
+
+  /// decoded length must fit in bytes left before anything is allocated for it.
+  template<typename store_ty>
+  AMSG_INLINE bool check_read_length(store_ty& store_data, uint32_t len, ::std::size_t min_size)
+  {
+    if ((uint64_t)len * min_size > (uint64_t)read_remain(store_data))
+    {
+      store_data.set_error_code(stream_buffer_overflow);
+      return false;
+    }
+    return true;
+  }
+
   AMSG_INLINE uint32_t size_of(bool)
   {
     return 1;
@@ -468,7 +968,7 @@ namespace amsg
   AMSG_INLINE void write(store_ty& store_data, const bool& value)
   {
     uint8_t val = value ? 1 : 0;
-    store_data.write((char*)&value, 1);
+    store_data.write((char*)&val, 1);
     if (store_data.bad())
     {
       store_data.set_error_code(stream_buffer_overflow);
@@ -479,60 +979,26 @@ namespace amsg
 
   template<typename value_type>
   AMSG_INLINE
-    typename ::std::enable_if<::std::is_signed<value_type>::value && ::std::is_integral<value_type>::value, uint32_t>::type
+    typename ::std::enable_if<::std::is_integral<value_type>::value, uint32_t>::type
     size_of(const value_type& value)
   {
-    if (0 <= value && value < const_tag_as_type)
+    uint8_t negative_bit = 0;
+    uint64_t temp = integer_magnitude(value, negative_bit);
+    if (negative_bit == 0 && temp < const_tag_as_type)
     {
       return 1;
     }
-    else
-    {
-      value_type temp = value;
-      if (value < 0)
-      {
-        temp = -value;
-      }
-      if (temp < 0x100)
-      {
-        return 2;
-      }
-      else if (temp < 0x10000)
-      {
-        return 3;
-      }
-      else if (temp < 0x1000000)
-      {
-        return 4;
-      }
-      else if (temp < 0x100000000)
-      {
-        return 5;
-      }
-      else if (temp < 0x10000000000LL)
-      {
-        return 6;
-      }
-      else if (temp < 0x1000000000000LL)
-      {
-        return 7;
-      }
-      else if (temp < 0x100000000000000LL)
-      {
-        return 8;
-      }
-    }
-    return 9;
-  }
-
-  template<typename store_ty, typename value_type>
-  AMSG_INLINE
-    typename ::std::enable_if<::std::is_integral<value_type>::value, void>::type
-    skip_read(store_ty& store_data, value_type *)
-  {
-    uint8_t tag;
-    store_data.read((char*)&tag, 1);
-    if (store_data.bad())
+    return 1 + integer_value_bytes(temp);
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<::std::is_integral<value_type>::value, void>::type
+    skip_read(store_ty& store_data, value_type *)
+  {
+    uint8_t tag;
+    store_data.read((char*)&tag, 1);
+    if (store_data.bad())
     {
       store_data.set_error_code(stream_buffer_overflow);
       return;
@@ -597,64 +1063,12 @@ namespace amsg
 
   template<typename store_ty, typename value_type>
   AMSG_INLINE
-    typename ::std::enable_if<::std::is_signed<value_type>::value && ::std::is_integral<value_type>::value, void>::type
+    typename ::std::enable_if<::std::is_integral<value_type>::value, void>::type
     write(store_ty& store_data, const value_type& value)
   {
-    value_type write_value[2] = { 0 };
-    int write_bytes = 0;
-    uint8_t * ptr = (uint8_t *)write_value;
-    uint8_t tag = static_cast<uint8_t>(value);
-    write_bytes = 1;
-    if (0 <= value && value < const_tag_as_type)
-    {
-      write_value[0] = tag;
-    }
-    else
-    {
-      uint8_t negative_bit = 0;
-      value_type temp = value;
-      if (value < 0)
-      {
-        negative_bit = const_negative_bit_value;
-        temp = -value;
-      }
-      write_value[1] = host_to_le(temp);
-      ptr = (uint8_t *)(&write_value[1]) - 1;
-      if (temp < 0x100)
-      {
-        write_bytes = 2;
-      }
-      else if (temp < 0x10000)
-      {
-        write_bytes = 3;
-      }
-      else if (temp < 0x1000000)
-      {
-        write_bytes = 4;
-      }
-      else if (temp < 0x100000000)
-      {
-        write_bytes = 5;
-      }
-      else if (temp < 0x10000000000LL)
-      {
-        write_bytes = 6;
-      }
-      else if (temp < 0x1000000000000LL)
-      {
-        write_bytes = 7;
-      }
-      else if (temp < 0x100000000000000LL)
-      {
-        write_bytes = 8;
-      }
-      else
-      {
-        write_bytes = 9;
-      }
-      *ptr = const_store_postive_integer_byte_mask + negative_bit + write_bytes;
-    }
-    store_data.write((const char *)ptr, write_bytes);
+    uint8_t write_buff[16];
+    uint8_t * end = encode_integer(write_buff, value);
+    store_data.write((const char *)write_buff, end - write_buff);
     if (store_data.bad())
     {
       store_data.set_error_code(stream_buffer_overflow);
@@ -664,45 +1078,10 @@ namespace amsg
 
   template<typename value_type>
   AMSG_INLINE
-    typename ::std::enable_if<::std::is_unsigned<value_type>::value && ::std::is_integral<value_type>::value, uint32_t>::type
-    size_of(const value_type& value)
+    typename ::std::enable_if<::std::is_integral<value_type>::value && !::std::is_same<value_type, bool>::value, void>::type
+    write(unchecked_write_buffer& store_data, const value_type& value)
   {
-    if (value < const_tag_as_type)
-    {
-      return 1;
-    }
-    else
-    {
-      if (value < 0x100)
-      {
-        return 2;
-      }
-      else if (value < 0x10000)
-      {
-        return 3;
-      }
-      else if (value < 0x1000000)
-      {
-        return 4;
-      }
-      else if (value < 0x100000000)
-      {
-        return 5;
-      }
-      else if (value < 0x10000000000LL)
-      {
-        return 6;
-      }
-      else if (value < 0x1000000000000LL)
-      {
-        return 7;
-      }
-      else if (value < 0x100000000000000LL)
-      {
-        return 8;
-      }
-    }
-    return 9;
+    store_data.m_write_ptr = encode_integer(store_data.m_write_ptr, value);
   }
 
   template<typename store_ty, typename value_type>
@@ -745,66 +1124,6 @@ namespace amsg
     }
   }
 
-  template<typename store_ty, typename value_type>
-  AMSG_INLINE
-    typename ::std::enable_if<::std::is_unsigned<value_type>::value && ::std::is_integral<value_type>::value, void>::type
-    write(store_ty& store_data, const value_type& value)
-  {
-    value_type write_value[2] = { 0 };
-    int write_bytes = 0;
-    uint8_t * ptr = (uint8_t *)write_value;
-    uint8_t tag = static_cast<uint8_t>(value);
-    write_bytes = 1;
-    if (value < const_tag_as_type)
-    {
-      write_value[0] = tag;
-    }
-    else
-    {
-      write_value[1] = host_to_le(value);
-      ptr = (uint8_t *)(&write_value[1]) - 1;
-      if (value < 0x100)
-      {
-        write_bytes = 2;
-      }
-      else if (value < 0x10000)
-      {
-        write_bytes = 3;
-      }
-      else if (value < 0x1000000)
-      {
-        write_bytes = 4;
-      }
-      else if (value < 0x100000000)
-      {
-        write_bytes = 5;
-      }
-      else if (value < 0x10000000000LL)
-      {
-        write_bytes = 6;
-      }
-      else if (value < 0x1000000000000LL)
-      {
-        write_bytes = 7;
-      }
-      else if (value < 0x100000000000000LL)
-      {
-        write_bytes = 8;
-      }
-      else
-      {
-        write_bytes = 9;
-      }
-      *ptr = (uint8_t)(const_store_postive_integer_byte_mask + write_bytes);
-    }
-    store_data.write((const char *)ptr, write_bytes);
-    if (store_data.bad())
-    {
-      store_data.set_error_code(stream_buffer_overflow);
-      return;
-    }
-  }
-
   template<typename value_type>
   AMSG_INLINE
     typename ::std::enable_if<::std::is_enum<value_type>::value, uint32_t>::type
@@ -813,6 +1132,15 @@ namespace amsg
     return size_of((int64_t)value);
   }
 
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<::std::is_enum<value_type>::value, void>::type
+    skip_read(store_ty& store_data, value_type *)
+  {
+    int64_t * data = nullptr;
+    skip_read(store_data, data);
+  }
+
   template<typename store_ty, typename value_type>
   AMSG_INLINE
     typename ::std::enable_if<::std::is_enum<value_type>::value, void>::type
@@ -862,7 +1190,7 @@ namespace amsg
   AMSG_INLINE void write(store_ty& store_data, const float& value)
   {
     float data = host_to_le(value);
-    store_data.write((char*)&data, sizeof(double));
+    store_data.write((char*)&data, sizeof(float));
     if (store_data.bad())
     {
       store_data.set_error_code(stream_buffer_overflow);
@@ -909,7 +1237,7 @@ namespace amsg
   template<typename alloc_ty>
   AMSG_INLINE uint32_t size_of(const ::std::basic_string<char, ::std::char_traits<char>, alloc_ty>& value, uint32_t max = 0)
   {
-    (max);
+    (void)max;
     uint32_t len = (uint32_t)value.length();
     return size_of(len) + len;
   }
@@ -923,24 +1251,27 @@ namespace amsg
   template<typename store_ty, typename alloc_ty>
   AMSG_INLINE void skip_read(store_ty& store_data, ::std::basic_string<char, ::std::char_traits<char>, alloc_ty>*, uint32_t max = 0)
   {
-    (max);
-    uint32_t len;
+    (void)max;
+    uint32_t len = 0;
     read(store_data, len);
     if (store_data.error())
     {
       return;
     }
     store_data.skip_read(len);
+    if (store_data.bad())
+    {
+      store_data.set_error_code(stream_buffer_overflow);
+    }
   }
 
   template<typename store_ty, typename alloc_ty>
   AMSG_INLINE void read(store_ty& store_data, ::std::basic_string<char, ::std::char_traits<char>, alloc_ty>& value, uint32_t max = 0)
   {
-    uint32_t len;
+    uint32_t len = 0;
     read(store_data, len);
-    if (store_data.bad())
+    if (store_data.error())
     {
-      store_data.set_error_code(stream_buffer_overflow);
       return;
     }
     if (max > 0 && max < len)
@@ -948,6 +1279,10 @@ namespace amsg
       store_data.set_error_code(sequence_length_overflow);
       return;
     }
+    if (!check_read_length(store_data, len, 1) || !store_data.charge_decode(0, len))
+    {
+      return;
+    }
     value.resize(len);
     store_data.read((char*)value.data(), len);
     if (store_data.bad())
@@ -972,7 +1307,114 @@ namespace amsg
       store_data.set_error_code(stream_buffer_overflow);
       return;
     }
-    store_data.write(value.data(), len);
+    write_raw(store_data, value.data(), len);
+    if (store_data.bad())
+    {
+      store_data.set_error_code(stream_buffer_overflow);
+      return;
+    }
+  }
+
+  /// non-owning string bytes, same serialization as std::string.
+  /// read from zero_copy_buffer points into its read region, valid while that region is.
+  struct bytes_view
+  {
+    bytes_view()
+      : m_data(0)
+      , m_size(0)
+    {
+    }
+
+    bytes_view(char const* data, ::std::size_t size)
+      : m_data(data)
+      , m_size(size)
+    {
+    }
+
+    template<typename alloc_ty>
+    bytes_view(const ::std::basic_string<char, ::std::char_traits<char>, alloc_ty>& value)
+      : m_data(value.data())
+      , m_size(value.size())
+    {
+    }
+
+    AMSG_INLINE char const* data() const { return this->m_data; }
+    AMSG_INLINE ::std::size_t size() const { return this->m_size; }
+    AMSG_INLINE ::std::size_t length() const { return this->m_size; }
+    AMSG_INLINE bool empty() const { return this->m_size == 0; }
+    AMSG_INLINE char const* begin() const { return this->m_data; }
+    AMSG_INLINE char const* end() const { return this->m_data + this->m_size; }
+
+    AMSG_INLINE ::std::string str() const
+    {
+      return ::std::string(this->m_data, this->m_size);
+    }
+
+    AMSG_INLINE bool operator == (const bytes_view& rhs) const
+    {
+      return this->m_size == rhs.m_size && (this->m_size == 0 || ::std::memcmp(this->m_data, rhs.m_data, this->m_size) == 0);
+    }
+
+    AMSG_INLINE bool operator != (const bytes_view& rhs) const
+    {
+      return !(*this == rhs);
+    }
+
+  private:
+    char const* m_data;
+    ::std::size_t m_size;
+  };
+
+  template<typename type>
+  struct is_bytes_view : public ::std::false_type{};
+
+  template<>
+  struct is_bytes_view<bytes_view> : public ::std::true_type{};
+
+#ifdef AMSG_HAS_STRING_VIEW
+  template<typename traits_ty>
+  struct is_bytes_view< ::std::basic_string_view<char, traits_ty> > : public ::std::true_type{};
+
+  template<typename traits_ty>
+  AMSG_INLINE bool can_skip(const ::std::basic_string_view<char, traits_ty>& value)
+  {
+    return value.empty();
+  }
+#endif
+
+  AMSG_INLINE bool can_skip(const bytes_view& value)
+  {
+    return value.empty();
+  }
+
+  template<typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<is_bytes_view<value_type>::value, uint32_t>::type
+    size_of(const value_type& value, uint32_t max = 0)
+  {
+    (void)max;
+    uint32_t len = (uint32_t)value.length();
+    return size_of(len) + len;
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<is_bytes_view<value_type>::value, void>::type
+    write(store_ty& store_data, const value_type& value, uint32_t max = 0)
+  {
+    uint32_t len = (uint32_t)value.length();
+    if (max > 0 && max < len)
+    {
+      store_data.set_error_code(sequence_length_overflow);
+      return;
+    }
+    write(store_data, len);
+    if (store_data.bad())
+    {
+      store_data.set_error_code(stream_buffer_overflow);
+      return;
+    }
+    write_raw(store_data, value.data(), len);
     if (store_data.bad())
     {
       store_data.set_error_code(stream_buffer_overflow);
@@ -1000,7 +1442,7 @@ namespace amsg
     typename ::std::enable_if<is_sequence_container<value_type>::value, uint32_t>::type
     size_of(const value_type& value, uint32_t max = 0)
   {
-    (max);
+    (void)max;
     uint32_t len = 0;
     uint32_t size = 0;
     for (typename value_type::const_iterator i = value.begin(); i != value.end(); ++i, ++len)
@@ -1047,8 +1489,8 @@ namespace amsg
     typename ::std::enable_if<is_sequence_container<value_type>::value, void>::type
     skip_read(store_ty& store_data, value_type*, uint32_t max = 0)
   {
-    (max);
-    uint32_t len;
+    (void)max;
+    uint32_t len = 0;
     read(store_data, len);
     if (store_data.error())
     {
@@ -1057,28 +1499,48 @@ namespace amsg
     for (uint32_t i = 0; i < len; ++i)
     {
       typename value_type::value_type* elem_value = nullptr;
-      skip_read(elem_value);
+      skip_read(store_data, elem_value);
+      if (store_data.error())
+      {
+        return;
+      }
     }
   }
 
+  template<typename value_type>
+  AMSG_INLINE void reserve_sequence(value_type&, uint32_t)
+  {
+  }
+
+  template<typename value_type, typename alloc_ty>
+  AMSG_INLINE void reserve_sequence(::std::vector<value_type, alloc_ty>& value, uint32_t len)
+  {
+    value.reserve(len);
+  }
+
+  template<typename value_type>
+  AMSG_INLINE uint32_t sequence_size(const value_type& value)
+  {
+    return (uint32_t)value.size();
+  }
+
+  /// forward_list has no size.
+  template<typename value_type, typename alloc_ty>
+  AMSG_INLINE uint32_t sequence_size(const ::std::forward_list<value_type, alloc_ty>& value)
+  {
+    return (uint32_t)::std::distance(value.begin(), value.end());
+  }
+
   template<typename store_ty, typename value_type>
-  AMSG_INLINE
-    typename ::std::enable_if<is_sequence_container<value_type>::value, void>::type
-    read(store_ty& store_data, value_type& value, uint32_t max = 0)
+  AMSG_INLINE void read_sequence_elements(store_ty& store_data, value_type& value, uint32_t len)
   {
-    uint32_t len;
-    read(store_data, len);
-    if (store_data.bad())
-    {
-      store_data.set_error_code(stream_buffer_overflow);
-      return;
-    }
-    if (max > 0 && max < len)
+    // elements already there are decoded in place (keeping their buffers),
+    // missing ones are built in place one by one, never all before decoding.
+    if (value.size() > len)
     {
-      store_data.set_error_code(sequence_length_overflow);
-      return;
+      value.resize(len);
     }
-    value.resize(len);
+    reserve_sequence(value, len);
     uint32_t c = 0;
     for (typename value_type::iterator i = value.begin(); i != value.end(); ++i, ++c)
     {
@@ -1086,11 +1548,17 @@ namespace amsg
       read(store_data, elem_value);
       if (store_data.error())
       {
-        char buffer[64];
-        to_str(c, buffer, 64);
-        store_data.append_debug_info("[");
-        store_data.append_debug_info(buffer);
-        store_data.append_debug_info("]");
+        AMSG_ERROR_INDEX(store_data, c);
+        return;
+      }
+    }
+    for (; c < len; ++c)
+    {
+      value.emplace_back();
+      read(store_data, value.back());
+      if (store_data.error())
+      {
+        AMSG_ERROR_INDEX(store_data, c);
         return;
       }
     }
@@ -1099,34 +1567,86 @@ namespace amsg
   template<typename store_ty, typename value_type>
   AMSG_INLINE
     typename ::std::enable_if<is_sequence_container<value_type>::value, void>::type
-    write(store_ty& store_data, const value_type& value, uint32_t max = 0)
+    read(store_ty& store_data, value_type& value, uint32_t max = 0)
   {
-    uint32_t len = (uint32_t)value.size();
-    if (max > 0 && max < len)
+    uint32_t len = 0;
+    read(store_data, len);
+    if (store_data.error())
     {
-      store_data.set_error_code(sequence_length_overflow);
       return;
     }
-    write(store_data, len);
-    if (store_data.bad())
+    if (max > 0 && max < len)
     {
-      store_data.set_error_code(stream_buffer_overflow);
+      store_data.set_error_code(sequence_length_overflow);
       return;
     }
-    uint32_t c = 0;
-    for (typename value_type::const_iterator i = value.begin(); i != value.end(); ++i, ++c)
+    if (!check_read_length(store_data, len, min_size_of<typename value_type::value_type>()) ||
+      !store_data.charge_decode(len, (uint64_t)len * sizeof(typename value_type::value_type)))
     {
-      const typename value_type::value_type& elem_value = *i;
-      write(store_data, elem_value);
-      if (store_data.error())
-      {
-        char buffer[64];
-        to_str(c, buffer, 64);
-        store_data.append_debug_info("[");
-        store_data.append_debug_info(buffer);
-        store_data.append_debug_info("]");
-        return;
-      }
+      return;
+    }
+    read_sequence_elements(store_data, value, len);
+  }
+
+  template<typename store_ty, typename value_type, typename alloc_ty>
+  AMSG_INLINE void read(store_ty& store_data, ::std::forward_list<value_type, alloc_ty>& value, uint32_t max = 0)
+  {
+    uint32_t len = 0;
+    read(store_data, len);
+    if (store_data.error())
+    {
+      return;
+    }
+    if (max > 0 && max < len)
+    {
+      store_data.set_error_code(sequence_length_overflow);
+      return;
+    }
+    if (!check_read_length(store_data, len, min_size_of<value_type>()) ||
+      !store_data.charge_decode(len, (uint64_t)len * sizeof(value_type)))
+    {
+      return;
+    }
+    value.resize(len);
+    uint32_t c = 0;
+    for (typename ::std::forward_list<value_type, alloc_ty>::iterator i = value.begin(); i != value.end(); ++i, ++c)
+    {
+      read(store_data, *i);
+      if (store_data.error())
+      {
+        AMSG_ERROR_INDEX(store_data, c);
+        return;
+      }
+    }
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<is_sequence_container<value_type>::value, void>::type
+    write(store_ty& store_data, const value_type& value, uint32_t max = 0)
+  {
+    uint32_t len = sequence_size(value);
+    if (max > 0 && max < len)
+    {
+      store_data.set_error_code(sequence_length_overflow);
+      return;
+    }
+    write(store_data, len);
+    if (store_data.bad())
+    {
+      store_data.set_error_code(stream_buffer_overflow);
+      return;
+    }
+    uint32_t c = 0;
+    for (typename value_type::const_iterator i = value.begin(); i != value.end(); ++i, ++c)
+    {
+      const typename value_type::value_type& elem_value = *i;
+      write(store_data, elem_value);
+      if (store_data.error())
+      {
+        AMSG_ERROR_INDEX(store_data, c);
+        return;
+      }
     }
   }
 
@@ -1136,12 +1656,15 @@ namespace amsg
   template<typename type, ::std::size_t size>
   struct is_array< ::std::array<type, size> > : public ::std::true_type{};
 
+  template<typename type, ::std::size_t size>
+  struct is_array< ::boost::array<type, size> > : public ::std::true_type{};
+
   template<typename value_type>
   AMSG_INLINE
     typename ::std::enable_if<is_array<value_type>::value, uint32_t>::type
     size_of(const value_type& value, uint32_t max = 0)
   {
-    (max);
+    (void)max;
     uint32_t size = (uint32_t)value.size();
     size = size_of(size);
     for (typename value_type::const_iterator i = value.begin(); i != value.end(); ++i)
@@ -1156,8 +1679,8 @@ namespace amsg
     typename ::std::enable_if<is_array<value_type>::value, void>::type
     skip_read(store_ty& store_data, value_type*, uint32_t max = 0)
   {
-    (max);
-    uint32_t len;
+    (void)max;
+    uint32_t len = 0;
     read(store_data, len);
     if (store_data.error())
     {
@@ -1166,7 +1689,11 @@ namespace amsg
     for (uint32_t i = 0; i < len; ++i)
     {
       typename value_type::value_type* elem_value = nullptr;
-      skip_read(elem_value);
+      skip_read(store_data, elem_value);
+      if (store_data.error())
+      {
+        return;
+      }
     }
   }
 
@@ -1175,11 +1702,10 @@ namespace amsg
     typename ::std::enable_if<is_array<value_type>::value, void>::type
     read(store_ty& store_data, value_type& value, uint32_t max = 0)
   {
-    uint32_t len;
+    uint32_t len = 0;
     read(store_data, len);
-    if (store_data.bad())
+    if (store_data.error())
     {
-      store_data.set_error_code(stream_buffer_overflow);
       return;
     }
     if (max > 0 && max < len)
@@ -1194,11 +1720,7 @@ namespace amsg
       read(store_data, elem_value);
       if (store_data.error())
       {
-        char buffer[64];
-        to_str(c, buffer, 64);
-        store_data.append_debug_info("[");
-        store_data.append_debug_info(buffer);
-        store_data.append_debug_info("]");
+        AMSG_ERROR_INDEX(store_data, c);
         return;
       }
     }
@@ -1233,11 +1755,7 @@ namespace amsg
       write(store_data, elem_value);
       if (store_data.error())
       {
-        char buffer[64];
-        to_str(c, buffer, 64);
-        store_data.append_debug_info("[");
-        store_data.append_debug_info(buffer);
-        store_data.append_debug_info("]");
+        AMSG_ERROR_INDEX(store_data, c);
         return;
       }
     }
@@ -1252,12 +1770,21 @@ namespace amsg
   template<typename key_ty, typename ty, typename cmp_ty, typename alloc_ty>
   struct is_unordered_container< ::std::unordered_map<key_ty, ty, cmp_ty, alloc_ty> > : public ::std::true_type{};
 
+  template<typename key_ty, typename ty, typename cmp_ty, typename alloc_ty>
+  struct is_unordered_container< ::std::multimap<key_ty, ty, cmp_ty, alloc_ty> > : public ::std::true_type{};
+
+  template<typename key_ty, typename ty, typename hash_ty, typename eq_ty, typename alloc_ty>
+  struct is_unordered_container< ::std::unordered_multimap<key_ty, ty, hash_ty, eq_ty, alloc_ty> > : public ::std::true_type{};
+
+  template<typename key_ty, typename ty, typename hash_ty, typename eq_ty, typename alloc_ty>
+  struct is_unordered_container< ::boost::unordered_map<key_ty, ty, hash_ty, eq_ty, alloc_ty> > : public ::std::true_type{};
+
   template<typename value_type>
   AMSG_INLINE
     typename ::std::enable_if<is_unordered_container<value_type>::value, uint32_t>::type
     size_of(const value_type& value, uint32_t max = 0)
   {
-    (max);
+    (void)max;
     uint32_t len = 0;
     uint32_t size = 0;
     for (typename value_type::const_iterator i = value.begin(); i != value.end(); ++i, ++len)
@@ -1288,13 +1815,31 @@ namespace amsg
     return value.empty();
   }
 
+  template<typename key_ty, typename ty, typename cmp_ty, typename alloc_ty>
+  AMSG_INLINE bool can_skip(const ::std::multimap<key_ty, ty, cmp_ty, alloc_ty>& value)
+  {
+    return value.empty();
+  }
+
+  template<typename key_ty, typename ty, typename hash_ty, typename eq_ty, typename alloc_ty>
+  AMSG_INLINE bool can_skip(const ::std::unordered_multimap<key_ty, ty, hash_ty, eq_ty, alloc_ty>& value)
+  {
+    return value.empty();
+  }
+
+  template<typename key_ty, typename ty, typename hash_ty, typename eq_ty, typename alloc_ty>
+  AMSG_INLINE bool can_skip(const ::boost::unordered_map<key_ty, ty, hash_ty, eq_ty, alloc_ty>& value)
+  {
+    return value.empty();
+  }
+
   template<typename store_ty, typename value_type>
   AMSG_INLINE
     typename ::std::enable_if<is_unordered_container<value_type>::value, void>::type
     skip_read(store_ty& store_data, value_type*, uint32_t max = 0)
   {
-    (max);
-    uint32_t len;
+    (void)max;
+    uint32_t len = 0;
     read(store_data, len);
     if (store_data.error())
     {
@@ -1302,23 +1847,60 @@ namespace amsg
     }
     for (uint32_t i = 0; i < len; ++i)
     {
-      typename value_type::value_type::first_type* value1 = nullptr;
+      typename ::std::remove_const<typename value_type::value_type::first_type>::type* value1 = nullptr;
       typename value_type::value_type::second_type* value2 = nullptr;
-      skip_read(value1);
-      skip_read(value2);
+      skip_read(store_data, value1);
+      if (!store_data.error())
+      {
+        skip_read(store_data, value2);
+      }
+      if (store_data.error())
+      {
+        return;
+      }
     }
   }
 
+  template<typename value_type>
+  AMSG_INLINE void reserve_map(value_type&, uint32_t)
+  {
+  }
+
+  template<typename key_ty, typename ty, typename cmp_ty, typename alloc_ty>
+  AMSG_INLINE void reserve_map(::std::unordered_map<key_ty, ty, cmp_ty, alloc_ty>& value, uint32_t len)
+  {
+    value.reserve(value.size() + len);
+  }
+
+  /// map key or value to decode into, built with map's allocator when it takes one,
+  /// so strings and containers in it allocate where map nodes do.
+  template<typename value_type, typename alloc_ty>
+  AMSG_INLINE
+    typename ::std::enable_if<::std::uses_allocator<value_type, alloc_ty>::value &&
+    ::std::is_constructible<value_type, const alloc_ty&>::value, value_type>::type
+    make_element(const alloc_ty& alloc)
+  {
+    return value_type(alloc);
+  }
+
+  template<typename value_type, typename alloc_ty>
+  AMSG_INLINE
+    typename ::std::enable_if<!(::std::uses_allocator<value_type, alloc_ty>::value &&
+    ::std::is_constructible<value_type, const alloc_ty&>::value), value_type>::type
+    make_element(const alloc_ty&)
+  {
+    return value_type();
+  }
+
   template<typename store_ty, typename value_type>
   AMSG_INLINE
     typename ::std::enable_if<is_unordered_container<value_type>::value, void>::type
     read(store_ty& store_data, value_type& value, uint32_t max = 0)
   {
-    uint32_t len;
+    uint32_t len = 0;
     read(store_data, len);
-    if (store_data.bad())
+    if (store_data.error())
     {
-      store_data.set_error_code(stream_buffer_overflow);
       return;
     }
     if (max > 0 && max < len)
@@ -1326,26 +1908,32 @@ namespace amsg
       store_data.set_error_code(sequence_length_overflow);
       return;
     }
+    if (!check_read_length(store_data, len,
+      min_size_of<typename value_type::key_type>() + min_size_of<typename value_type::mapped_type>()) ||
+      !store_data.charge_decode(len, (uint64_t)len * sizeof(typename value_type::value_type)))
+    {
+      return;
+    }
+    reserve_map(value, len);
     for (uint32_t c = 0; c < len; ++c)
     {
-      typename ::std::remove_const<value_type::value_type::first_type>::type value1;
-      typename value_type::value_type::second_type value2;
+      typename ::std::remove_const<typename value_type::value_type::first_type>::type value1 =
+        make_element<typename ::std::remove_const<typename value_type::value_type::first_type>::type>(value.get_allocator());
+      typename value_type::value_type::second_type value2 =
+        make_element<typename value_type::value_type::second_type>(value.get_allocator());
       read(store_data, value1);
       if (!store_data.error())
       {
         read(store_data, value2);
         if (!store_data.error())
         {
-          value.insert(std::make_pair(value1, value2));
+          // keys are written in map order, end hint makes a sorted input load in O(n)
+          value.emplace_hint(value.end(), ::std::move(value1), ::std::move(value2));
         }
       }
       if (store_data.error())
       {
-        char buffer[64];
-        to_str(c, buffer, 64);
-        store_data.append_debug_info("[");
-        store_data.append_debug_info(buffer);
-        store_data.append_debug_info("]");
+        AMSG_ERROR_INDEX(store_data, c);
         return;
       }
     }
@@ -1380,11 +1968,136 @@ namespace amsg
       }
       if (store_data.error())
       {
-        char buffer[64];
-        to_str(c, buffer, 64);
-        store_data.append_debug_info("[");
-        store_data.append_debug_info(buffer);
-        store_data.append_debug_info("]");
+        AMSG_ERROR_INDEX(store_data, c);
+        return;
+      }
+    }
+  }
+
+  /// sets go like sequences: length then elements, read inserts them.
+  template<typename type>
+  struct is_set_container : public ::std::false_type{};
+
+  template<typename key_ty, typename cmp_ty, typename alloc_ty>
+  struct is_set_container< ::std::set<key_ty, cmp_ty, alloc_ty> > : public ::std::true_type{};
+
+  template<typename key_ty, typename cmp_ty, typename alloc_ty>
+  struct is_set_container< ::std::multiset<key_ty, cmp_ty, alloc_ty> > : public ::std::true_type{};
+
+  template<typename key_ty, typename hash_ty, typename eq_ty, typename alloc_ty>
+  struct is_set_container< ::std::unordered_set<key_ty, hash_ty, eq_ty, alloc_ty> > : public ::std::true_type{};
+
+  template<typename key_ty, typename hash_ty, typename eq_ty, typename alloc_ty>
+  struct is_set_container< ::std::unordered_multiset<key_ty, hash_ty, eq_ty, alloc_ty> > : public ::std::true_type{};
+
+  template<typename key_ty, typename hash_ty, typename eq_ty, typename alloc_ty>
+  struct is_set_container< ::boost::unordered_set<key_ty, hash_ty, eq_ty, alloc_ty> > : public ::std::true_type{};
+
+  template<typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<is_set_container<value_type>::value, uint32_t>::type
+    size_of(const value_type& value, uint32_t max = 0)
+  {
+    (void)max;
+    uint32_t len = 0;
+    uint32_t size = 0;
+    for (typename value_type::const_iterator i = value.begin(); i != value.end(); ++i, ++len)
+    {
+      size += size_of(*i);
+    }
+    return size + size_of(len);
+  }
+
+  template<typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<is_set_container<value_type>::value, bool>::type
+    can_skip(const value_type& value)
+  {
+    return value.empty();
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<is_set_container<value_type>::value, void>::type
+    skip_read(store_ty& store_data, value_type*, uint32_t max = 0)
+  {
+    (void)max;
+    uint32_t len = 0;
+    read(store_data, len);
+    if (store_data.error())
+    {
+      return;
+    }
+    for (uint32_t i = 0; i < len; ++i)
+    {
+      typename value_type::value_type* elem_value = nullptr;
+      skip_read(store_data, elem_value);
+      if (store_data.error())
+      {
+        return;
+      }
+    }
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<is_set_container<value_type>::value, void>::type
+    read(store_ty& store_data, value_type& value, uint32_t max = 0)
+  {
+    uint32_t len = 0;
+    read(store_data, len);
+    if (store_data.error())
+    {
+      return;
+    }
+    if (max > 0 && max < len)
+    {
+      store_data.set_error_code(sequence_length_overflow);
+      return;
+    }
+    if (!check_read_length(store_data, len, min_size_of<typename value_type::value_type>()) ||
+      !store_data.charge_decode(len, (uint64_t)len * sizeof(typename value_type::value_type)))
+    {
+      return;
+    }
+    for (uint32_t c = 0; c < len; ++c)
+    {
+      typename value_type::value_type elem_value =
+        make_element<typename value_type::value_type>(value.get_allocator());
+      read(store_data, elem_value);
+      if (store_data.error())
+      {
+        AMSG_ERROR_INDEX(store_data, c);
+        return;
+      }
+      value.emplace_hint(value.end(), ::std::move(elem_value));
+    }
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<is_set_container<value_type>::value, void>::type
+    write(store_ty& store_data, const value_type& value, uint32_t max = 0)
+  {
+    uint32_t len = (uint32_t)value.size();
+    if (max > 0 && max < len)
+    {
+      store_data.set_error_code(sequence_length_overflow);
+      return;
+    }
+    write(store_data, len);
+    if (store_data.bad())
+    {
+      store_data.set_error_code(stream_buffer_overflow);
+      return;
+    }
+    uint32_t c = 0;
+    for (typename value_type::const_iterator i = value.begin(); i != value.end(); ++i, ++c)
+    {
+      write(store_data, *i);
+      if (store_data.error())
+      {
+        AMSG_ERROR_INDEX(store_data, c);
         return;
       }
     }
@@ -1395,14 +2108,14 @@ namespace amsg
     typename ::std::enable_if<::std::is_integral<value_type>::value, uint32_t>::type
     size_of(const sfix_op<value_type>& value)
   {
-    (value);
+    (void)value;
     return sizeof(value.val);
   }
 
   template<typename store_ty, typename value_type>
   AMSG_INLINE
     typename ::std::enable_if<::std::is_integral<value_type>::value, void>::type
-    skip_read(store_ty& store_data, sfix_op<value_type>&)
+    skip_read(store_ty& store_data, const sfix_op<value_type>&)
   {
     store_data.skip_read(sizeof(value_type));
     if (store_data.bad())
@@ -1437,44 +2150,783 @@ namespace amsg
     }
   }
 
-  template<typename value_type>
-  AMSG_INLINE uint32_t size_of(const smax_valid<value_type>& value)
-  {
-    return size_of(value.val);
-  }
+  /// sfix on vector or array of arithmetic type: length and raw little endian elements.
+  template<typename type>
+  struct is_fix_sequence : public ::std::false_type{};
+
+  template<typename type, typename alloc_type>
+  struct is_fix_sequence< ::std::vector<type, alloc_type> >
+    : public ::std::integral_constant<bool, ::std::is_arithmetic<type>::value && !::std::is_same<type, bool>::value>{};
+
+  template<typename type, ::std::size_t size>
+  struct is_fix_sequence< ::std::array<type, size> >
+    : public ::std::integral_constant<bool, ::std::is_arithmetic<type>::value && !::std::is_same<type, bool>::value>{};
+
+  template<typename type>
+  struct is_fix_sequence<const type> : public is_fix_sequence<type>{};
 
   template<typename value_type>
-  AMSG_INLINE bool can_skip(const smax_valid<value_type>& value)
+  AMSG_INLINE
+    typename ::std::enable_if<is_fix_sequence<value_type>::value, uint32_t>::type
+    size_of(const sfix_op<value_type>& value)
   {
-    return can_skip(value.val);
+    uint32_t len = (uint32_t)value.val.size();
+    return size_of(len) + len * (uint32_t)sizeof(typename value_type::value_type);
   }
 
-  template<typename store_ty, typename value_type>
-  AMSG_INLINE void skip_read(store_ty& store_data, const smax_valid<value_type>& value)
+  template<typename value_type, typename alloc_ty>
+  AMSG_INLINE void resize_fix_sequence(::std::vector<value_type, alloc_ty>& value, uint32_t len, basic_store&)
   {
-    skip_read(store_data, &value.val);
+    value.resize(len);
   }
 
-  template<typename store_ty, typename value_type>
-  AMSG_INLINE void read(store_ty& store_data, const smax_valid<value_type>& value)
+  template<typename value_type, ::std::size_t size>
+  AMSG_INLINE void resize_fix_sequence(::std::array<value_type, size>&, uint32_t len, basic_store& store_data)
   {
-    smax_valid<value_type> * ptr = (smax_valid<value_type>*)&value;
-    read(store_data, ptr->val, ptr->size);
+    if (len != size)
+    {
+      store_data.set_error_code(number_of_element_not_macth);
+    }
   }
 
   template<typename store_ty, typename value_type>
-  AMSG_INLINE void write(store_ty& store_data, const smax_valid<value_type>& value)
+  AMSG_INLINE
+    typename ::std::enable_if<is_fix_sequence<value_type>::value, void>::type
+    read(store_ty& store_data, const sfix_op<value_type>& value)
   {
-    write(store_data, value.val, value.size);
-  }
-
-}
-
-#define AMSG_TAG_MEMBER_X( r ,v , elem ) \
-  if(!can_skip(v.elem))	\
-  {\
-    tag |= mask;\
-  }\
+    typedef typename value_type::value_type elem_type;
+    uint32_t len = 0;
+    read(store_data, len);
+    if (store_data.error())
+    {
+      return;
+    }
+    if (!check_read_length(store_data, len, sizeof(elem_type)) ||
+      !store_data.charge_decode(len, (uint64_t)len * sizeof(elem_type)))
+    {
+      return;
+    }
+    resize_fix_sequence(value.val, len, store_data);
+    if (store_data.error() || len == 0)
+    {
+      return;
+    }
+    store_data.read((char*)&value.val[0], len * sizeof(elem_type));
+    if (store_data.bad())
+    {
+      store_data.set_error_code(stream_buffer_overflow);
+      return;
+    }
+#if !defined(__LITTLE_ENDIAN__)
+    for (uint32_t i = 0; i < len; ++i)
+    {
+      value.val[i] = le_to_host(value.val[i]);
+    }
+#endif
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<is_fix_sequence<value_type>::value, void>::type
+    write(store_ty& store_data, const sfix_op<value_type>& value)
+  {
+    typedef typename value_type::value_type elem_type;
+    uint32_t len = (uint32_t)value.val.size();
+    write(store_data, len);
+    if (store_data.error() || len == 0)
+    {
+      return;
+    }
+#if defined(__LITTLE_ENDIAN__)
+    write_raw(store_data, (const char*)&value.val[0], len * sizeof(elem_type));
+#else
+    for (uint32_t i = 0; i < len; ++i)
+    {
+      elem_type data = host_to_le(value.val[i]);
+      store_data.write((const char*)&data, sizeof(elem_type));
+    }
+#endif
+    if (store_data.bad())
+    {
+      store_data.set_error_code(stream_buffer_overflow);
+    }
+  }
+
+  template<typename value_type>
+  AMSG_INLINE uint32_t size_of(const smax_valid<value_type>& value)
+  {
+    return size_of(value.val);
+  }
+
+  template<typename value_type>
+  AMSG_INLINE bool can_skip(const smax_valid<value_type>& value)
+  {
+    return can_skip(value.val);
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE void skip_read(store_ty& store_data, const smax_valid<value_type>& value)
+  {
+    skip_read(store_data, &value.val);
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE void read(store_ty& store_data, const smax_valid<value_type>& value)
+  {
+    smax_valid<value_type> * ptr = (smax_valid<value_type>*)&value;
+    read(store_data, ptr->val, ptr->size);
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE void write(store_ty& store_data, const smax_valid<value_type>& value)
+  {
+    write(store_data, value.val, value.size);
+  }
+
+  /// sidx on vector: length, stride, body size, then body of offset table (4 bytes little endian
+  /// offset of every stride-th element, from first element) and elements. A reader finds element i
+  /// skipping at most stride - 1 elements, skip_read jumps over body at once.
+  AMSG_INLINE uint32_t sidx_entries(uint32_t len, uint32_t stride)
+  {
+    return len == 0 ? 0 : (len - 1) / stride + 1;
+  }
+
+  template<typename type>
+  struct is_sidx_sequence : public ::std::false_type{};
+
+  template<typename type, typename alloc_type>
+  struct is_sidx_sequence< ::std::vector<type, alloc_type> > : public ::std::true_type{};
+
+  template<typename type>
+  struct is_sidx_sequence<const type> : public is_sidx_sequence<type>{};
+
+  template<typename value_type>
+  AMSG_INLINE uint32_t sidx_body_size(const sidx_valid<value_type>& value)
+  {
+    uint32_t len = (uint32_t)value.val.size();
+    uint32_t size = sidx_entries(len, value.stride) * 4;
+    for (uint32_t i = 0; i < len; ++i)
+    {
+      size += size_of(value.val[i]);
+    }
+    return size;
+  }
+
+  template<typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<is_sidx_sequence<value_type>::value, uint32_t>::type
+    size_of(const sidx_valid<value_type>& value)
+  {
+    uint32_t body = sidx_body_size(value);
+    return size_of((uint32_t)value.val.size()) + size_of(value.stride) + size_of(body) + body;
+  }
+
+  template<typename value_type>
+  AMSG_INLINE bool can_skip(const sidx_valid<value_type>& value)
+  {
+    return can_skip(value.val);
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<is_sidx_sequence<value_type>::value, void>::type
+    write(store_ty& store_data, const sidx_valid<value_type>& value)
+  {
+    // one pass over elements gives both the table and body size.
+    uint32_t len = (uint32_t)value.val.size();
+    ::std::vector<uint32_t> table(sidx_entries(len, value.stride));
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < len; ++i)
+    {
+      if (i % value.stride == 0)
+      {
+        table[i / value.stride] = host_to_le(offset);
+      }
+      offset += size_of(value.val[i]);
+    }
+    write(store_data, len);
+    write(store_data, value.stride);
+    write(store_data, (uint32_t)(table.size() * 4 + offset));
+    if (store_data.error())
+    {
+      return;
+    }
+    if (!table.empty())
+    {
+      store_data.write((const char*)&table[0], table.size() * 4);
+    }
+    if (store_data.bad())
+    {
+      store_data.set_error_code(stream_buffer_overflow);
+      return;
+    }
+    for (uint32_t i = 0; i < len; ++i)
+    {
+      write(store_data, value.val[i]);
+      if (store_data.error())
+      {
+        AMSG_ERROR_INDEX(store_data, i);
+        return;
+      }
+    }
+  }
+
+  /// reads length, stride and body size, leaves store at offset table. false on error.
+  template<typename store_ty>
+  AMSG_INLINE bool read_sidx_header(store_ty& store_data, uint32_t& len, uint32_t& stride, uint32_t& body)
+  {
+    read(store_data, len);
+    read(store_data, stride);
+    read(store_data, body);
+    if (store_data.error())
+    {
+      return false;
+    }
+    if (stride == 0 || (uint64_t)sidx_entries(len, stride) * 4 > body)
+    {
+      store_data.set_error_code(stream_buffer_overflow);
+      return false;
+    }
+    return check_read_length(store_data, body, 1);
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<is_sidx_sequence<value_type>::value, void>::type
+    skip_read(store_ty& store_data, const sidx_valid<value_type>&)
+  {
+    uint32_t len, stride, body;
+    if (!read_sidx_header(store_data, len, stride, body))
+    {
+      return;
+    }
+    store_data.skip_read(body);
+    if (store_data.bad())
+    {
+      store_data.set_error_code(stream_buffer_overflow);
+    }
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<is_sidx_sequence<value_type>::value, void>::type
+    read(store_ty& store_data, const sidx_valid<value_type>& value)
+  {
+    typedef typename value_type::value_type elem_type;
+    uint32_t len, stride, body;
+    if (!read_sidx_header(store_data, len, stride, body))
+    {
+      return;
+    }
+    ::std::size_t offset = store_data.read_length();
+    uint32_t table = sidx_entries(len, stride) * 4;
+    store_data.skip_read(table);
+    if (store_data.bad())
+    {
+      store_data.set_error_code(stream_buffer_overflow);
+      return;
+    }
+    if (!check_read_length(store_data, len, min_size_of<elem_type>()) ||
+      !store_data.charge_decode(len, (uint64_t)len * sizeof(elem_type)))
+    {
+      return;
+    }
+    read_sequence_elements(store_data, value.val, len);
+    if (store_data.error())
+    {
+      return;
+    }
+    ::std::size_t read_len = store_data.read_length() - offset;
+    if (read_len > body)
+    {
+      store_data.set_error_code(stream_buffer_overflow);
+    }
+    else if (read_len < body)
+    {
+      store_data.skip_read(body - read_len);
+    }
+  }
+
+  /// AMSG struct skipped by its length prefix, members are not decoded.
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<struct_traits<value_type>::value, void>::type
+    skip_read(store_ty& store_data, value_type *)
+  {
+    ::std::size_t offset = store_data.read_length();
+    uint32_t len_tag = 0;
+    read(store_data, len_tag);
+    if (store_data.error())
+    {
+      return;
+    }
+    ::std::size_t read_len = store_data.read_length() - offset;
+    if (len_tag < read_len)
+    {
+      store_data.set_error_code(stream_buffer_overflow);
+      return;
+    }
+    store_data.skip_read(len_tag - read_len);
+    if (store_data.bad())
+    {
+      store_data.set_error_code(stream_buffer_overflow);
+    }
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<is_bytes_view<value_type>::value, void>::type
+    skip_read(store_ty& store_data, value_type *, uint32_t max = 0)
+  {
+    ::std::string * str = nullptr;
+    skip_read(store_data, str, max);
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<is_fix_sequence<value_type>::value, void>::type
+    skip_read(store_ty& store_data, const sfix_op<value_type>&)
+  {
+    uint32_t len = 0;
+    read(store_data, len);
+    if (store_data.error())
+    {
+      return;
+    }
+    store_data.skip_read((uint64_t)len * sizeof(typename value_type::value_type));
+    if (store_data.bad())
+    {
+      store_data.set_error_code(stream_buffer_overflow);
+    }
+  }
+
+  /// skip an AMSG member as it is written in member list, decorated by smax or sfix or not.
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE void skip_member(store_ty& store_data, value_type& value)
+  {
+    skip_read(store_data, ::std::addressof(value));
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE void skip_member(store_ty& store_data, const smax_valid<value_type>& value)
+  {
+    skip_read(store_data, value);
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE void skip_member(store_ty& store_data, const sfix_op<value_type>& value)
+  {
+    skip_read(store_data, value);
+  }
+
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE void skip_member(store_ty& store_data, const sidx_valid<value_type>& value)
+  {
+    skip_read(store_data, value);
+  }
+
+  template<typename value_type>
+  AMSG_INLINE const void * member_address(const value_type& value)
+  {
+    return ::std::addressof(value);
+  }
+
+  template<typename value_type>
+  AMSG_INLINE const void * member_address(const smax_valid<value_type>& value)
+  {
+    return ::std::addressof(value.val);
+  }
+
+  template<typename value_type>
+  AMSG_INLINE const void * member_address(const sfix_op<value_type>& value)
+  {
+    return ::std::addressof(value.val);
+  }
+
+  template<typename value_type>
+  AMSG_INLINE const void * member_address(const sidx_valid<value_type>& value)
+  {
+    return ::std::addressof(value.val);
+  }
+
+  /// type of a member as written in member list, decorated by smax, sfix or sidx or not.
+  template<typename value_type>
+  struct member_value
+  {
+    typedef typename ::std::remove_cv<value_type>::type type;
+  };
+
+  template<typename value_type>
+  struct member_value<smax_valid<value_type> > : public member_value<value_type>{};
+
+  template<typename value_type>
+  struct member_value<sfix_op<value_type> > : public member_value<value_type>{};
+
+  template<typename value_type>
+  struct member_value<sidx_valid<value_type> > : public member_value<value_type>{};
+
+  /// decode a member into out with member's decoration, out is of member's type (true_type).
+  template<typename store_ty, typename value_type, typename out_ty>
+  AMSG_INLINE void read_member_as(store_ty& store_data, value_type&, out_ty& out, ::std::true_type)
+  {
+    read(store_data, out);
+  }
+
+  template<typename store_ty, typename value_type, typename out_ty>
+  AMSG_INLINE void read_member_as(store_ty& store_data, const smax_valid<value_type>& value, out_ty& out, ::std::true_type)
+  {
+    read(store_data, out&smax(value.size));
+  }
+
+  template<typename store_ty, typename value_type, typename out_ty>
+  AMSG_INLINE void read_member_as(store_ty& store_data, const sfix_op<value_type>&, out_ty& out, ::std::true_type)
+  {
+    read(store_data, out&sfix);
+  }
+
+  template<typename store_ty, typename value_type, typename out_ty>
+  AMSG_INLINE void read_member_as(store_ty& store_data, const sidx_valid<value_type>& value, out_ty& out, ::std::true_type)
+  {
+    read(store_data, out&sidx(value.stride));
+  }
+
+  /// member of other type than out, never at index asked.
+  template<typename store_ty, typename value_type, typename out_ty>
+  AMSG_INLINE void read_member_as(store_ty&, const value_type&, out_ty&, ::std::false_type)
+  {
+  }
+
+  /// resumable decode step of a member (push.hpp): AMSG structs and vectors are entered
+  /// member by member and element by element, others are decoded whole once their bytes are in.
+  enum push_status
+  {
+    push_done,
+    push_need_more,
+    push_failed
+  };
+
+  template<typename ctx_ty, typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<struct_traits<value_type>::value, int>::type
+    push_member(ctx_ty& ctx, value_type& value, const char * name)
+  {
+    return ctx.push_struct(value, name);
+  }
+
+  template<typename ctx_ty, typename value_type, typename alloc_ty>
+  AMSG_INLINE
+    typename ::std::enable_if<!::std::is_same<value_type, bool>::value, int>::type
+    push_member(ctx_ty& ctx, ::std::vector<value_type, alloc_ty>& value, const char * name)
+  {
+    return ctx.push_sequence(value, name);
+  }
+
+  template<typename ctx_ty, typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<!struct_traits<value_type>::value, int>::type
+    push_member(ctx_ty& ctx, value_type& value, const char * name)
+  {
+    return ctx.read_leaf(value, name);
+  }
+
+  template<typename ctx_ty, typename value_type>
+  AMSG_INLINE int push_member(ctx_ty& ctx, const smax_valid<value_type>& value, const char * name)
+  {
+    return ctx.read_leaf(value, name);
+  }
+
+  template<typename ctx_ty, typename value_type>
+  AMSG_INLINE int push_member(ctx_ty& ctx, const sfix_op<value_type>& value, const char * name)
+  {
+    return ctx.read_leaf(value, name);
+  }
+
+  template<typename ctx_ty, typename value_type>
+  AMSG_INLINE int push_member(ctx_ty& ctx, const sidx_valid<value_type>& value, const char * name)
+  {
+    return ctx.read_leaf(value, name);
+  }
+
+  /// projection read, fields are bits of AMSG members in declared order (same as tag bits),
+  /// by field_set<index...> at compile time or field_of at run time.
+  template<uint32_t... index>
+  struct field_set;
+
+  template<>
+  struct field_set<>
+  {
+    static constexpr uint64_t value = 0;
+  };
+
+  template<uint32_t first, uint32_t... rest>
+  struct field_set<first, rest...>
+  {
+    static_assert(first < 64, "amsg::field_set: AMSG struct has 64 members at most.");
+    static constexpr uint64_t value = (1ULL << first) | field_set<rest...>::value;
+  };
+
+  template<typename value_type, typename member_ty>
+  AMSG_INLINE uint64_t field_of(const value_type& value, const member_ty& member)
+  {
+    return struct_traits<value_type>::field_of(value, ::std::addressof(member));
+  }
+
+  /// decode only members in fields, others are skipped without allocation, struct ends by its length prefix.
+  template<typename store_ty, typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<struct_traits<value_type>::value, void>::type
+    read_fields(store_ty& store_data, value_type& value, uint64_t fields)
+  {
+    struct_traits<value_type>::read_fields(store_data, value, fields);
+  }
+
+  template<typename fields_ty, typename store_ty, typename value_type>
+  AMSG_INLINE void read_fields(store_ty& store_data, value_type& value)
+  {
+    read_fields(store_data, value, fields_ty::value);
+  }
+
+  /// compile time max serialize size, AMSG struct members are described by member pointer:
+  /// &TYPE::name&smax(30) is (&TYPE::name) & smax(30).
+  template <typename value_type>
+  struct sfix_member
+  {
+  };
+
+  template <typename value_type>
+  struct smax_member
+  {
+    uint32_t size;
+    constexpr smax_member(uint32_t max)
+      :size(max)
+    {}
+  };
+
+  template<typename value_type, typename class_type>
+  constexpr sfix_member<value_type> operator & (value_type class_type::*, const sfix_def&)
+  {
+    return sfix_member<value_type>();
+  }
+
+  template<typename value_type, typename class_type>
+  constexpr smax_member<value_type> operator & (value_type class_type::*, const smax& sm)
+  {
+    return smax_member<value_type>(sm.size);
+  }
+
+  template <typename value_type>
+  struct sidx_member
+  {
+  };
+
+  template<typename value_type, typename class_type>
+  constexpr sidx_member<value_type> operator & (value_type class_type::*, const sidx&)
+  {
+    return sidx_member<value_type>();
+  }
+
+  constexpr ::std::size_t max_size_of_bytes(uint64_t value)
+  {
+    return value < 0x100 ? 1 : 1 + max_size_of_bytes(value >> 8);
+  }
+
+  /// serialize size of an unsigned integer known at compile time.
+  constexpr ::std::size_t size_of_constant(uint64_t value)
+  {
+    return value < const_tag_as_type ? 1 : 1 + max_size_of_bytes(value);
+  }
+
+  constexpr ::std::size_t bounded_length(uint32_t max)
+  {
+    return max > 0 ? max : throw "amsg::max_size_of: smax(0) is unbounded.";
+  }
+
+  template<typename value_type, typename enable_ty = void>
+  struct max_size_traits
+  {
+    static_assert(sizeof(value_type) == 0, "amsg::max_size_of: unbounded type, limit it with smax.");
+  };
+
+  template<>
+  struct max_size_traits<bool, void>
+  {
+    static constexpr ::std::size_t max_size_of()
+    {
+      return 1;
+    }
+  };
+
+  template<typename value_type>
+  struct max_size_traits<value_type, typename ::std::enable_if<::std::is_integral<value_type>::value && !::std::is_same<value_type, bool>::value>::type>
+  {
+    static constexpr ::std::size_t max_size_of()
+    {
+      return 1 + sizeof(value_type);
+    }
+  };
+
+  template<typename value_type>
+  struct max_size_traits<value_type, typename ::std::enable_if<::std::is_enum<value_type>::value>::type>
+  {
+    static constexpr ::std::size_t max_size_of()
+    {
+      return 1 + sizeof(int64_t);
+    }
+  };
+
+  template<typename value_type>
+  struct max_size_traits<value_type, typename ::std::enable_if<::std::is_floating_point<value_type>::value>::type>
+  {
+    static constexpr ::std::size_t max_size_of()
+    {
+      return sizeof(value_type);
+    }
+  };
+
+  template<typename alloc_ty>
+  struct max_size_traits< ::std::basic_string<char, ::std::char_traits<char>, alloc_ty>, void>
+  {
+    static constexpr ::std::size_t max_size_of()
+    {
+      static_assert(sizeof(alloc_ty) == 0, "amsg::max_size_of: unbounded type, limit it with smax.");
+      return 0;
+    }
+
+    static constexpr ::std::size_t max_size_of(uint32_t max)
+    {
+      return size_of_constant(max) + bounded_length(max);
+    }
+  };
+
+  template<typename value_type>
+  struct max_size_traits<value_type, typename ::std::enable_if<is_bytes_view<value_type>::value>::type>
+  {
+    static constexpr ::std::size_t max_size_of()
+    {
+      static_assert(sizeof(value_type) == 0, "amsg::max_size_of: unbounded type, limit it with smax.");
+      return 0;
+    }
+
+    static constexpr ::std::size_t max_size_of(uint32_t max)
+    {
+      return size_of_constant(max) + bounded_length(max);
+    }
+  };
+
+  template<typename value_type>
+  struct max_size_traits<value_type, typename ::std::enable_if<is_sequence_container<value_type>::value>::type>
+  {
+    static constexpr ::std::size_t max_size_of()
+    {
+      static_assert(sizeof(value_type) == 0, "amsg::max_size_of: unbounded type, limit it with smax.");
+      return 0;
+    }
+
+    static constexpr ::std::size_t max_size_of(uint32_t max)
+    {
+      return size_of_constant(max) + bounded_length(max) * max_size_traits<typename value_type::value_type>::max_size_of();
+    }
+  };
+
+  template<typename value_type>
+  struct max_size_traits<value_type, typename ::std::enable_if<is_unordered_container<value_type>::value>::type>
+  {
+    static constexpr ::std::size_t max_size_of()
+    {
+      static_assert(sizeof(value_type) == 0, "amsg::max_size_of: unbounded type, limit it with smax.");
+      return 0;
+    }
+
+    static constexpr ::std::size_t max_size_of(uint32_t max)
+    {
+      return size_of_constant(max) + bounded_length(max) *
+        (max_size_traits<typename value_type::key_type>::max_size_of() +
+        max_size_traits<typename value_type::mapped_type>::max_size_of());
+    }
+  };
+
+  template<typename value_type, ::std::size_t size>
+  struct max_size_traits< ::std::array<value_type, size>, void>
+  {
+    static constexpr ::std::size_t max_size_of()
+    {
+      return size_of_constant(size) + size * max_size_traits<value_type>::max_size_of();
+    }
+
+    static constexpr ::std::size_t max_size_of(uint32_t)
+    {
+      return max_size_of();
+    }
+  };
+
+  template<typename value_type>
+  struct max_size_traits<value_type, typename ::std::enable_if<struct_traits<value_type>::value>::type>
+  {
+    static constexpr ::std::size_t max_size_of()
+    {
+      return struct_traits<value_type>::template max_size_of<value_type>();
+    }
+  };
+
+  template<typename value_type, typename class_type>
+  constexpr ::std::size_t max_size_of_member(value_type class_type::*)
+  {
+    return max_size_traits<value_type>::max_size_of();
+  }
+
+  template<typename value_type>
+  constexpr typename ::std::enable_if<!is_fix_sequence<value_type>::value, ::std::size_t>::type
+    max_size_of_member(const sfix_member<value_type>&)
+  {
+    return sizeof(value_type);
+  }
+
+  template<typename value_type, ::std::size_t size>
+  constexpr ::std::size_t max_size_of_member(const sfix_member< ::std::array<value_type, size> >&)
+  {
+    return size_of_constant(size) + size * sizeof(value_type);
+  }
+
+  template<typename value_type, typename alloc_ty>
+  constexpr ::std::size_t max_size_of_member(const sfix_member< ::std::vector<value_type, alloc_ty> >&)
+  {
+    static_assert(sizeof(value_type) == 0, "amsg::max_size_of: unbounded type, limit it with smax.");
+    return 0;
+  }
+
+  template<typename value_type>
+  constexpr ::std::size_t max_size_of_member(const smax_member<value_type>& member)
+  {
+    return max_size_traits<value_type>::max_size_of(member.size);
+  }
+
+  template<typename value_type>
+  constexpr ::std::size_t max_size_of_member(const sidx_member<value_type>&)
+  {
+    static_assert(sizeof(value_type) == 0, "amsg::max_size_of: unbounded type, sidx sequence has no max.");
+    return 0;
+  }
+
+  /// members' max size + tag + length prefix.
+  constexpr ::std::size_t max_size_of_struct(::std::size_t size, ::std::size_t member_count)
+  {
+    return size + size_of_constant(member_count >= 64 ? ~0ULL : (1ULL << member_count) - 1)
+      + size_of_constant(size + size_of_constant(member_count >= 64 ? ~0ULL : (1ULL << member_count) - 1) + 5);
+  }
+
+  template<typename value_type>
+  constexpr ::std::size_t max_size_of()
+  {
+    return max_size_traits<value_type>::max_size_of();
+  }
+
+}
+
+#define AMSG_TAG_MEMBER_X( r ,v , elem ) \
+  if(!can_skip(v.elem))	\
+  {\
+    tag |= mask;\
+  }\
   mask <<= 1;
 
 #define AMSG_SIZE_MEMBER_X( r ,v , elem ) \
@@ -1485,27 +2937,77 @@ namespace amsg
   }\
   mask <<= 1;
 
+#define AMSG_MAX_SIZE_MEMBER_X( r ,ty , elem ) \
+  + ::amsg::max_size_of_member(&ty::elem)
+
 #define AMSG_READ_MEMBER( r , v , elem ) \
   if(tag&mask)\
   {\
 	  ::amsg::read(store_data,v.elem);\
   	if(store_data.error())\
     {\
-	  store_data.append_debug_info(".");\
-	  store_data.append_debug_info(BOOST_PP_STRINGIZE(elem));\
+	  AMSG_ERROR_MEMBER(store_data, BOOST_PP_STRINGIZE(elem));\
 	  return;\
     }\
   }\
   mask <<= 1;
 
+#define AMSG_READ_FIELD_MEMBER( r , v , elem ) \
+  if((tag&fields) < mask) break;\
+  if(tag&mask)\
+  {\
+    if(fields&mask) ::amsg::read(store_data, v.elem);\
+    else ::amsg::skip_member(store_data, v.elem);\
+    if(store_data.error())\
+    {\
+      AMSG_ERROR_MEMBER(store_data, BOOST_PP_STRINGIZE(elem));\
+      return;\
+    }\
+  }\
+  mask <<= 1;
+
+#define AMSG_FIELD_OF_MEMBER( r , v , elem ) \
+  if(::amsg::member_address(v.elem) == member) return mask;\
+  mask <<= 1;
+
+#define AMSG_READ_INDEX_MEMBER( r , v , elem ) \
+  if(i++ == index)\
+  {\
+    ::amsg::read_member_as(store_data, v.elem, out,\
+      ::std::is_same<typename ::amsg::member_value<typename ::std::decay<decltype(v.elem)>::type>::type, member_ty>());\
+    if(store_data.error())\
+    {\
+      AMSG_ERROR_MEMBER(store_data, BOOST_PP_STRINGIZE(elem));\
+    }\
+    return;\
+  }
+
+#define AMSG_PUSH_INDEX_MEMBER( r , v , elem ) \
+  if(i++ == index) return ::amsg::push_member(ctx, v.elem, BOOST_PP_STRINGIZE(elem));
+
+#define AMSG_INDEXED_MEMBER( r , ty , elem ) \
+  if(i++ == index) return ::amsg::is_sidx<decltype(::std::declval<ty&>().elem)>::value;
+
+#define AMSG_OFFSET_MEMBER( r , v , elem ) \
+  offsets[i++] = (uint32_t)store_data.read_length();\
+  if(tag&mask)\
+  {\
+    ::amsg::skip_member(store_data, v.elem);\
+    if(store_data.error())\
+    {\
+      AMSG_ERROR_MEMBER(store_data, BOOST_PP_STRINGIZE(elem));\
+      return;\
+    }\
+  }\
+  mask <<= 1;
+
 #define AMSG_WRITE_MEMBER( r ,v , elem ) \
   if(tag&mask)\
   {\
     ::amsg::write(store_data, v.elem); \
     if (store_data.error())\
     {\
-    store_data.append_debug_info("."); \
-    store_data.append_debug_info(BOOST_PP_STRINGIZE(elem)); \
+    AMSG_ERROR_MEMBER(store_data, BOOST_PP_STRINGIZE(elem)); \
     return; \
     }\
   }\
@@ -1524,6 +3026,101 @@ AMSG_INLINE uint32_t size_of(const TYPE& value)\
 	return size;\
 }\
 \
+template<>\
+struct struct_traits<TYPE> : public ::std::true_type\
+{\
+  static AMSG_INLINE uint32_t size_of(const TYPE& value)\
+  {\
+    return ::amsg::size_of(value);\
+  }\
+\
+  template<typename ty>\
+  static constexpr ::std::size_t max_size_of()\
+  {\
+    return ::amsg::max_size_of_struct(0 BOOST_PP_SEQ_FOR_EACH( AMSG_MAX_SIZE_MEMBER_X , ty , MEMBERS ), BOOST_PP_SEQ_SIZE(MEMBERS));\
+  }\
+\
+  template<typename store_ty>\
+  static AMSG_INLINE void write_members(store_ty& store_data, const TYPE& value, uint64_t tag)\
+  {\
+    uint64_t mask = 1;\
+    BOOST_PP_SEQ_FOR_EACH( AMSG_WRITE_MEMBER , value , MEMBERS ) \
+  }\
+\
+  static uint64_t field_of(const TYPE& value, const void * member)\
+  {\
+    uint64_t mask = 1;\
+    BOOST_PP_SEQ_FOR_EACH( AMSG_FIELD_OF_MEMBER , value , MEMBERS ) \
+    return 0;\
+  }\
+\
+  enum { member_count = BOOST_PP_SEQ_SIZE(MEMBERS) };\
+\
+  /* decode index-th member only into out (of that member's type), store is at the member's */\
+  /* first byte. value gives decoration of members, nothing of it is written. */\
+  template<typename store_ty, typename member_ty>\
+  static void read_member(store_ty& store_data, const TYPE& value, member_ty& out, uint32_t index)\
+  {\
+    uint32_t i = 0;\
+    BOOST_PP_SEQ_FOR_EACH( AMSG_READ_INDEX_MEMBER , value , MEMBERS ) \
+  }\
+\
+  /* resumable decode step of index-th member, push_status. */\
+  template<typename ctx_ty>\
+  static int push_member(ctx_ty& ctx, TYPE& value, uint32_t index)\
+  {\
+    uint32_t i = 0;\
+    BOOST_PP_SEQ_FOR_EACH( AMSG_PUSH_INDEX_MEMBER , value , MEMBERS ) \
+    return push_done;\
+  }\
+\
+  /* offsets[i] = read_length where i-th member starts, offsets[member_count] where last ends, store is after tag. */\
+  template<typename store_ty>\
+  static void member_offsets(store_ty& store_data, uint64_t tag, uint32_t * offsets)\
+  {\
+    TYPE value;\
+    uint32_t i = 0;\
+    uint64_t mask = 1;\
+    BOOST_PP_SEQ_FOR_EACH( AMSG_OFFSET_MEMBER , value , MEMBERS ) \
+    offsets[i] = (uint32_t)store_data.read_length();\
+  }\
+\
+  /* true if index-th member is a sidx sequence. */\
+  static bool indexed_member(uint32_t index)\
+  {\
+    uint32_t i = 0;\
+    BOOST_PP_SEQ_FOR_EACH( AMSG_INDEXED_MEMBER , TYPE , MEMBERS ) \
+    return false;\
+  }\
+\
+  template<typename store_ty>\
+  static void read_fields(store_ty& store_data, TYPE& value, uint64_t fields)\
+  {\
+    ::std::size_t offset = store_data.read_length();\
+    uint32_t len_tag = 0;\
+    uint64_t tag = 0;\
+    uint64_t mask = 1;\
+    read(store_data, len_tag);\
+    if(store_data.error()){return;}\
+    read_ahead(store_data, offset, len_tag);\
+    if(!store_data.enter_struct()){return;}\
+    read(store_data, tag);\
+    if(store_data.error()){return;}\
+    do\
+    {\
+      BOOST_PP_SEQ_FOR_EACH( AMSG_READ_FIELD_MEMBER , value , MEMBERS ) \
+    } while(false);\
+    store_data.leave_struct();\
+    ::std::size_t read_len = store_data.read_length() - offset;\
+    ::std::size_t len = (::std::size_t)len_tag;\
+    if(len > read_len)\
+    {\
+      store_data.skip_read(len - read_len);\
+      if(store_data.bad()){store_data.set_error_code(stream_buffer_overflow);}\
+    }\
+  }\
+};\
+\
 template<typename store_ty>	\
 AMSG_INLINE void read(store_ty& store_data, TYPE& value)\
 {\
@@ -1533,9 +3130,12 @@ AMSG_INLINE void read(store_ty& store_data, TYPE& value)\
   uint64_t mask = 1;\
   read(store_data, len_tag);\
   if(store_data.error()){return;}\
+  read_ahead(store_data, offset, len_tag);\
+  if(!store_data.enter_struct()){return;}\
   read(store_data,tag);\
   if (store_data.error()){return;}\
 	BOOST_PP_SEQ_FOR_EACH( AMSG_READ_MEMBER , value , MEMBERS ) \
+  store_data.leave_struct();\
   if(len_tag >= 0)\
   {\
     ::std::size_t read_len = store_data.read_length() - offset;\
@@ -1547,22 +3147,48 @@ AMSG_INLINE void read(store_ty& store_data, TYPE& value)\
 template<typename store_ty>	\
 AMSG_INLINE void write(store_ty& store_data, const TYPE& value)\
 {\
-	uint32_t size = size_of(value);\
   uint64_t tag = 0;\
   uint64_t mask = 1;\
   BOOST_PP_SEQ_FOR_EACH( AMSG_TAG_MEMBER_X , value , MEMBERS ) \
-  write(store_data, size);\
+  ::std::size_t prefix = 0;\
+  if(single_pass(store_data))\
+  {\
+    prefix = begin_length_prefix(store_data);\
+  }\
+  else\
+  {\
+    uint32_t size = size_of(value);\
+    unsigned char * room = unchecked_write_begin(store_data, size);\
+    if(room)\
+    {\
+      ::amsg::unchecked_write_buffer unchecked(room);\
+      write(unchecked, size);\
+      write(unchecked, tag);\
+      struct_traits<TYPE>::write_members(unchecked, value, tag);\
+      if(!unchecked.error())\
+      {\
+        unchecked_write_end(store_data, unchecked.m_write_ptr - room);\
+        return;\
+      }\
+    }\
+    write(store_data, size);\
+  }\
   if(store_data.error()){return;}\
   write(store_data,tag);\
   if(store_data.error()){return;}\
-  mask = 1;\
-	BOOST_PP_SEQ_FOR_EACH( AMSG_WRITE_MEMBER , value , MEMBERS ) \
+  struct_traits<TYPE>::write_members(store_data, value, tag);\
+  if(store_data.error()){return;}\
+  if(single_pass(store_data))\
+  {\
+    end_length_prefix(store_data, prefix);\
+  }\
 }\
 }
 
 #define AMSGF(TYPE,X)	\
   template <typename ty=TYPE> friend uint32_t ::amsg::size_of(ty&);\
 	template <typename store_ty,typename ty=TYPE> friend void ::amsg::read(store_ty&,ty&);\
-	template <typename store_ty,typename ty=TYPE> friend void ::amsg::write(store_ty&,const ty&);
+	template <typename store_ty,typename ty=TYPE> friend void ::amsg::write(store_ty&,const ty&);\
+  friend struct ::amsg::struct_traits<TYPE>;
 
 #endif
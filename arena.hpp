@@ -0,0 +1,266 @@
+///
+/// Copyright (c) 2012 - 2015 Ning Ding (lordoffox@gmail.com)
+///
+/// Distributed under the Boost Software License, Version 1.0. (See accompanying
+/// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+///
+/// See https://github.com/lordoffox/amsg for latest version.
+///
+
+#ifndef AMSG_ARENA_HPP
+#define AMSG_ARENA_HPP
+
+#include "amsg.hpp"
+#include <cstddef>
+#include <new>
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+# if defined(__has_include)
+#  if __has_include(<memory_resource>)
+#   include <memory_resource>
+#   if defined(__cpp_lib_memory_resource)
+#    define AMSG_HAS_MEMORY_RESOURCE
+#   endif
+#  endif
+# endif
+#endif
+
+namespace amsg
+{
+  /// monotonic arena: allocation bumps a pointer in blocks, deallocation does nothing.
+  /// reset rewinds it keeping blocks, so decoding message after message into it
+  /// stops calling malloc once blocks cover the largest message.
+  /// a memory resource too when std::pmr is there.
+  class arena
+#ifdef AMSG_HAS_MEMORY_RESOURCE
+    : public ::std::pmr::memory_resource
+#endif
+  {
+  public:
+    explicit arena(::std::size_t block_size = 64 * 1024)
+      : m_block_size(block_size > 256 ? block_size : 256)
+      , m_current(0)
+      , m_offset(0)
+      , m_used(0)
+    {
+    }
+
+    ~arena()
+    {
+      release();
+    }
+
+    void * allocate(::std::size_t size, ::std::size_t align = alignof(::std::max_align_t))
+    {
+      while (this->m_current < this->m_blocks.size())
+      {
+        block& current = this->m_blocks[this->m_current];
+        uintptr_t base = (uintptr_t)current.data;
+        ::std::size_t offset = (::std::size_t)(((base + this->m_offset + align - 1) & ~(uintptr_t)(align - 1)) - base);
+        if (offset + size <= current.size)
+        {
+          this->m_used += offset + size - this->m_offset;
+          this->m_offset = offset + size;
+          return current.data + offset;
+        }
+        ++this->m_current;
+        this->m_offset = 0;
+      }
+      // blocks are aligned for any type, larger ones hold a large allocation alone.
+      ::std::size_t block_size = size + align > this->m_block_size ? size + align : this->m_block_size;
+      block new_block;
+      new_block.data = (unsigned char *)::operator new(block_size);
+      new_block.size = block_size;
+      this->m_blocks.push_back(new_block);
+      this->m_current = this->m_blocks.size() - 1;
+      this->m_offset = 0;
+      return allocate(size, align);
+    }
+
+    AMSG_INLINE void deallocate(void *, ::std::size_t, ::std::size_t = alignof(::std::max_align_t))
+    {
+    }
+
+    /// everything allocated is gone, blocks are kept. objects in arena must be dead (or
+    /// never touched again) by then, their destructors free nothing.
+    AMSG_INLINE void reset()
+    {
+      this->m_current = 0;
+      this->m_offset = 0;
+      this->m_used = 0;
+    }
+
+    /// gives blocks back to heap.
+    void release()
+    {
+      for (::std::size_t i = 0; i < this->m_blocks.size(); ++i)
+      {
+        ::operator delete(this->m_blocks[i].data);
+      }
+      this->m_blocks.clear();
+      reset();
+    }
+
+    /// bytes allocated since reset, alignment padding counted.
+    AMSG_INLINE ::std::size_t used() const
+    {
+      return this->m_used;
+    }
+
+    /// bytes of blocks held.
+    AMSG_INLINE ::std::size_t capacity() const
+    {
+      ::std::size_t size = 0;
+      for (::std::size_t i = 0; i < this->m_blocks.size(); ++i)
+      {
+        size += this->m_blocks[i].size;
+      }
+      return size;
+    }
+
+  private:
+    arena(const arena&);
+    arena& operator = (const arena&);
+
+#ifdef AMSG_HAS_MEMORY_RESOURCE
+    void * do_allocate(::std::size_t size, ::std::size_t align) override
+    {
+      return allocate(size, align);
+    }
+
+    void do_deallocate(void *, ::std::size_t, ::std::size_t) override
+    {
+    }
+
+    bool do_is_equal(const ::std::pmr::memory_resource& other) const noexcept override
+    {
+      return this == &other;
+    }
+#endif
+
+    struct block
+    {
+      unsigned char * data;
+      ::std::size_t size;
+    };
+
+    ::std::size_t m_block_size;
+    ::std::vector<block> m_blocks;
+    ::std::size_t m_current;
+    ::std::size_t m_offset;
+    ::std::size_t m_used;
+  };
+
+  /// arena of this thread's innermost arena_scope, 0 outside any.
+  AMSG_INLINE arena *& current_arena()
+  {
+    static thread_local arena * current = 0;
+    return current;
+  }
+
+  /// arena_allocator built in scope allocates from arena, so strings, containers and map
+  /// nodes made by read (and AMSG structs default built) land in it.
+  class arena_scope
+  {
+  public:
+    explicit arena_scope(arena& value)
+      : m_prev(current_arena())
+    {
+      current_arena() = &value;
+    }
+
+    ~arena_scope()
+    {
+      current_arena() = this->m_prev;
+    }
+
+  private:
+    arena_scope(const arena_scope&);
+    arena_scope& operator = (const arena_scope&);
+
+    arena * m_prev;
+  };
+
+  /// allocator on an arena, default built one takes current_arena(), or heap outside a scope.
+  /// it goes with its container on move and swap. a copy of a container is on heap and copy
+  /// assignment keeps target's allocator, so what is copied out of an arena outlives it.
+  template<typename type>
+  class arena_allocator
+  {
+  public:
+    typedef type value_type;
+    typedef ::std::false_type propagate_on_container_copy_assignment;
+    typedef ::std::true_type propagate_on_container_move_assignment;
+    typedef ::std::true_type propagate_on_container_swap;
+
+    arena_allocator()
+      : m_arena(current_arena())
+    {
+    }
+
+    explicit arena_allocator(arena& value)
+      : m_arena(&value)
+    {
+    }
+
+    template<typename other_type>
+    arena_allocator(const arena_allocator<other_type>& other)
+      : m_arena(other.get_arena())
+    {
+    }
+
+    AMSG_INLINE arena * get_arena() const
+    {
+      return this->m_arena;
+    }
+
+    AMSG_INLINE arena_allocator select_on_container_copy_construction() const
+    {
+      arena_allocator heap(*this);
+      heap.m_arena = 0;
+      return heap;
+    }
+
+    AMSG_INLINE type * allocate(::std::size_t n)
+    {
+      if (this->m_arena == 0)
+      {
+        return ::std::allocator<type>().allocate(n);
+      }
+      return (type *)this->m_arena->allocate(n * sizeof(type), alignof(type));
+    }
+
+    AMSG_INLINE void deallocate(type * ptr, ::std::size_t n)
+    {
+      if (this->m_arena == 0)
+      {
+        ::std::allocator<type>().deallocate(ptr, n);
+      }
+    }
+
+  private:
+    arena * m_arena;
+  };
+
+  template<typename type, typename other_type>
+  AMSG_INLINE bool operator == (const arena_allocator<type>& lhs, const arena_allocator<other_type>& rhs)
+  {
+    return lhs.get_arena() == rhs.get_arena();
+  }
+
+  template<typename type, typename other_type>
+  AMSG_INLINE bool operator != (const arena_allocator<type>& lhs, const arena_allocator<other_type>& rhs)
+  {
+    return lhs.get_arena() != rhs.get_arena();
+  }
+
+  typedef ::std::basic_string<char, ::std::char_traits<char>, arena_allocator<char> > arena_string;
+
+  template<typename type>
+  using arena_vector = ::std::vector<type, arena_allocator<type> >;
+
+  template<typename key_ty, typename ty, typename cmp_ty = ::std::less<key_ty> >
+  using arena_map = ::std::map<key_ty, ty, cmp_ty, arena_allocator< ::std::pair<const key_ty, ty> > >;
+}
+
+#endif
@@ -0,0 +1,394 @@
+///
+/// Copyright (c) 2012 - 2015 Ning Ding (lordoffox@gmail.com)
+///
+/// Distributed under the Boost Software License, Version 1.0. (See accompanying
+/// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+///
+/// See https://github.com/lordoffox/amsg for latest version.
+///
+
+#ifndef AMSG_GROUP_WRITER_HPP
+#define AMSG_GROUP_WRITER_HPP
+
+#include "zerocopy.hpp"
+
+#ifndef _WIN32
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <cerrno>
+#include <climits>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace amsg
+{
+  /// block of records staged by one producer. bytes up to committed are whole records,
+  /// flushed is how many of them are written out.
+  struct group_block
+  {
+    ::std::vector<unsigned char> data;
+    ::std::atomic< ::std::size_t> committed;
+    ::std::size_t flushed;
+    bool sealed;
+
+    explicit group_block(::std::size_t size)
+      : data(size)
+      , committed(0)
+      , flushed(0)
+      , sealed(false)
+    {
+    }
+  };
+
+  /// blocks of one producer, in order. guarded by mutex but bytes and committed.
+  struct group_stage
+  {
+    ::std::mutex mutex;
+    ::std::condition_variable released;
+    ::std::deque<group_block *> blocks;
+    ::std::vector< ::std::unique_ptr<group_block> > pool;
+    ::std::vector<group_block *> free_blocks;
+    bool closed;
+
+    group_stage()
+      : closed(false)
+    {
+    }
+  };
+
+  /// writes AMSG records from many threads to a file descriptor in groups: producers encode
+  /// into their own staging blocks without locks or syscalls, a background thread writes what
+  /// is staged with writev every interval (and fdatasync if asked). records of one producer
+  /// keep their order, records of different producers interleave by whole records.
+  class group_writer
+  {
+  public:
+    /// one thread's handle, records appended by it are staged in blocks of its own.
+    /// a producer must be destroyed before its writer.
+    class producer
+    {
+    public:
+      explicit producer(group_writer& writer)
+        : m_writer(writer)
+        , m_stage(writer.add_stage())
+        , m_block(0)
+        , m_size(0)
+      {
+      }
+
+      ~producer()
+      {
+        ::std::lock_guard< ::std::mutex> lock(this->m_stage->mutex);
+        if (this->m_block != 0)
+        {
+          this->m_block->sealed = true;
+        }
+        this->m_stage->closed = true;
+        // sealed block and stage are released on next group, not an interval later.
+        this->m_writer.m_wake.notify_one();
+      }
+
+      /// false if value fails to encode or writer has failed.
+      template<typename value_type>
+      bool append(const value_type& value)
+      {
+        // a record staged after writer failed would never be written.
+        if (this->m_writer.error() != 0)
+        {
+          return false;
+        }
+        ::std::size_t len = size_of(value);
+        if (this->m_block == 0 || this->m_size + len > this->m_block->data.size())
+        {
+          if (!next_block(len))
+          {
+            return false;
+          }
+        }
+        zero_copy_buffer writer;
+        writer.set_write(&this->m_block->data[this->m_size], len);
+        write(writer, value);
+        if (writer.error())
+        {
+          return false;
+        }
+        this->m_size += len;
+        this->m_block->committed.store(this->m_size, ::std::memory_order_release);
+        return true;
+      }
+
+    private:
+      producer(const producer&);
+      producer& operator = (const producer&);
+
+      /// seals current block and takes a released one, waits while max_blocks are staged.
+      bool next_block(::std::size_t len)
+      {
+        group_stage& stage = *this->m_stage;
+        ::std::unique_lock< ::std::mutex> lock(stage.mutex);
+        if (this->m_block != 0)
+        {
+          this->m_block->sealed = true;
+          this->m_writer.m_wake.notify_one();
+        }
+        this->m_block = 0;
+        while (stage.blocks.size() >= this->m_writer.m_max_blocks && this->m_writer.error() == 0)
+        {
+          stage.released.wait(lock);
+        }
+        if (this->m_writer.error() != 0)
+        {
+          return false;
+        }
+        group_block * block = 0;
+        for (::std::size_t i = 0; i < stage.free_blocks.size(); ++i)
+        {
+          if (stage.free_blocks[i]->data.size() >= len)
+          {
+            block = stage.free_blocks[i];
+            stage.free_blocks.erase(stage.free_blocks.begin() + i);
+            break;
+          }
+        }
+        if (block == 0)
+        {
+          ::std::size_t size = this->m_writer.m_block_size > len ? this->m_writer.m_block_size : len;
+          stage.pool.emplace_back(new group_block(size));
+          block = stage.pool.back().get();
+        }
+        block->committed.store(0, ::std::memory_order_relaxed);
+        block->flushed = 0;
+        block->sealed = false;
+        stage.blocks.push_back(block);
+        this->m_block = block;
+        this->m_size = 0;
+        return true;
+      }
+
+      group_writer& m_writer;
+      group_stage * m_stage;
+      group_block * m_block;
+      ::std::size_t m_size;
+    };
+
+    /// interval bounds how long a record stays staged, max_blocks how many blocks a producer
+    /// stages before it waits for writes.
+    explicit group_writer(int fd, bool sync = false, uint32_t interval_us = 1000,
+      ::std::size_t block_size = 64 * 1024, ::std::size_t max_blocks = 16)
+      : m_fd(fd)
+      , m_sync(sync)
+      , m_interval(interval_us)
+      , m_block_size(block_size > 64 ? block_size : 64)
+      , m_max_blocks(max_blocks > 1 ? max_blocks : 2)
+      , m_error(0)
+      , m_running(true)
+      , m_requested(0)
+      , m_completed(0)
+    {
+      this->m_thread = ::std::thread([this]() { this->run(); });
+    }
+
+    /// writes what is staged, then stops.
+    ~group_writer()
+    {
+      {
+        ::std::lock_guard< ::std::mutex> lock(this->m_mutex);
+        this->m_running = false;
+      }
+      this->m_wake.notify_one();
+      this->m_thread.join();
+    }
+
+    /// errno of failed write or fdatasync, 0 if none. records are dropped after it.
+    AMSG_INLINE int error() const
+    {
+      return this->m_error.load(::std::memory_order_acquire);
+    }
+
+    /// waits until records staged before the call are written (and synced if asked).
+    bool flush()
+    {
+      ::std::unique_lock< ::std::mutex> lock(this->m_mutex);
+      uint64_t target = ++this->m_requested;
+      this->m_wake.notify_one();
+      while (this->m_completed < target)
+      {
+        this->m_done.wait(lock);
+      }
+      return error() == 0;
+    }
+
+  private:
+    group_writer(const group_writer&);
+    group_writer& operator = (const group_writer&);
+
+    group_stage * add_stage()
+    {
+      ::std::lock_guard< ::std::mutex> lock(this->m_mutex);
+      this->m_stages.emplace_back(new group_stage);
+      return this->m_stages.back().get();
+    }
+
+    void run()
+    {
+      ::std::unique_lock< ::std::mutex> lock(this->m_mutex);
+      for (;;)
+      {
+        if (this->m_running && this->m_completed == this->m_requested)
+        {
+          this->m_wake.wait_for(lock, this->m_interval);
+        }
+        bool running = this->m_running;
+        uint64_t target = this->m_requested;
+        ::std::vector<group_stage *> stages;
+        for (::std::size_t i = 0; i < this->m_stages.size(); ++i)
+        {
+          stages.push_back(this->m_stages[i].get());
+        }
+        lock.unlock();
+        write_group(stages);
+        lock.lock();
+        remove_closed();
+        this->m_completed = target;
+        this->m_done.notify_all();
+        if (!running)
+        {
+          return;
+        }
+      }
+    }
+
+    /// one group: everything committed so far, in one writev per IOV_MAX blocks.
+    void write_group(const ::std::vector<group_stage *>& stages)
+    {
+      ::std::vector<group_block *> blocks;
+      ::std::vector< ::std::size_t> ends;
+      ::std::vector<iovec> iov;
+      for (::std::size_t s = 0; s < stages.size(); ++s)
+      {
+        ::std::lock_guard< ::std::mutex> lock(stages[s]->mutex);
+        for (::std::size_t b = 0; b < stages[s]->blocks.size(); ++b)
+        {
+          group_block * block = stages[s]->blocks[b];
+          ::std::size_t end = block->committed.load(::std::memory_order_acquire);
+          if (end > block->flushed)
+          {
+            iovec vec;
+            vec.iov_base = &block->data[block->flushed];
+            vec.iov_len = end - block->flushed;
+            iov.push_back(vec);
+            blocks.push_back(block);
+            ends.push_back(end);
+          }
+        }
+      }
+      if (!iov.empty() && error() == 0 && write_all(iov) && this->m_sync && ::fdatasync(this->m_fd) != 0)
+      {
+        this->m_error.store(errno, ::std::memory_order_release);
+      }
+      // dropped after error too, producers are not kept waiting for room.
+      for (::std::size_t i = 0; i < blocks.size(); ++i)
+      {
+        blocks[i]->flushed = ends[i];
+      }
+      for (::std::size_t s = 0; s < stages.size(); ++s)
+      {
+        group_stage& stage = *stages[s];
+        ::std::lock_guard< ::std::mutex> lock(stage.mutex);
+        bool released = false;
+        while (!stage.blocks.empty() && stage.blocks.front()->sealed &&
+          stage.blocks.front()->flushed == stage.blocks.front()->committed.load(::std::memory_order_acquire))
+        {
+          stage.free_blocks.push_back(stage.blocks.front());
+          stage.blocks.pop_front();
+          released = true;
+        }
+        if (released || error() != 0)
+        {
+          stage.released.notify_all();
+        }
+      }
+    }
+
+    bool write_all(::std::vector<iovec>& iov)
+    {
+#ifdef IOV_MAX
+      const ::std::size_t iov_max = IOV_MAX;
+#else
+      const ::std::size_t iov_max = 1024;
+#endif
+      ::std::size_t i = 0;
+      while (i < iov.size())
+      {
+        ::std::size_t count = iov.size() - i < iov_max ? iov.size() - i : iov_max;
+        ssize_t done = ::writev(this->m_fd, &iov[i], (int)count);
+        if (done < 0)
+        {
+          if (errno == EINTR)
+          {
+            continue;
+          }
+          this->m_error.store(errno, ::std::memory_order_release);
+          return false;
+        }
+        ::std::size_t rest = (::std::size_t)done;
+        while (i < iov.size() && rest >= iov[i].iov_len)
+        {
+          rest -= iov[i].iov_len;
+          ++i;
+        }
+        if (rest > 0)
+        {
+          iov[i].iov_base = (char *)iov[i].iov_base + rest;
+          iov[i].iov_len -= rest;
+        }
+      }
+      return true;
+    }
+
+    /// stages of destroyed producers, once all they staged is written.
+    void remove_closed()
+    {
+      for (::std::size_t i = 0; i < this->m_stages.size();)
+      {
+        group_stage& stage = *this->m_stages[i];
+        bool done;
+        {
+          ::std::lock_guard< ::std::mutex> lock(stage.mutex);
+          done = stage.closed && stage.blocks.empty();
+        }
+        if (done)
+        {
+          this->m_stages.erase(this->m_stages.begin() + i);
+        }
+        else
+        {
+          ++i;
+        }
+      }
+    }
+
+    int m_fd;
+    bool m_sync;
+    ::std::chrono::microseconds m_interval;
+    ::std::size_t m_block_size;
+    ::std::size_t m_max_blocks;
+    ::std::atomic<int> m_error;
+    bool m_running;
+    uint64_t m_requested;
+    uint64_t m_completed;
+    ::std::mutex m_mutex;
+    ::std::condition_variable m_wake;
+    ::std::condition_variable m_done;
+    ::std::vector< ::std::unique_ptr<group_stage> > m_stages;
+    ::std::thread m_thread;
+  };
+}
+#endif
+
+#endif
@@ -0,0 +1,245 @@
+///
+/// Copyright (c) 2012 - 2015 Ning Ding (lordoffox@gmail.com)
+///
+/// Distributed under the Boost Software License, Version 1.0. (See accompanying
+/// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+///
+/// See https://github.com/lordoffox/amsg for latest version.
+///
+
+#ifndef AMSG_INPUT_HPP
+#define AMSG_INPUT_HPP
+
+#include "amsg.hpp"
+#include <functional>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <unistd.h>  /* read */
+#endif
+
+namespace amsg
+{
+  /// input store over a refill source keeping a bounded window of bytes: reads crossing
+  /// window end refill it, so a message larger than memory decodes in window size.
+  /// refill(buffer, len) puts at most len bytes to buffer and returns how many, 0 at end.
+  class input_buffer : public basic_store
+  {
+  public:
+    typedef ::std::function< ::std::size_t(unsigned char *, ::std::size_t)> refill_type;
+
+    enum { good, read_overflow };
+
+    explicit input_buffer(const refill_type& refill, ::std::size_t capacity = 64 * 1024)
+      : m_refill(refill)
+      , m_window(capacity > 16 ? capacity : 16)
+      , m_read_ptr(0)
+      , m_read_tail_ptr(0)
+      , m_offset(0)
+      , m_status(good)
+      , m_eof(false)
+    {
+      this->m_read_ptr = this->m_read_tail_ptr = &this->m_window[0];
+    }
+
+    /// error field path as text, built when asked.
+    AMSG_INLINE const ::std::string& info() const
+    {
+      this->m_error_info.clear();
+#ifndef AMSG_NO_ERROR_PATH
+      this->error_path().append_to(this->m_error_info);
+#endif
+      return this->m_error_info;
+    }
+
+    AMSG_INLINE bool bad() const
+    {
+      return this->m_status != good;
+    }
+
+    AMSG_INLINE void clear()
+    {
+      basic_store::clear();
+      this->m_status = good;
+      this->m_error_info.clear();
+    }
+
+    AMSG_INLINE ::std::size_t capacity() const
+    {
+      return this->m_window.size();
+    }
+
+    /// bytes in window not read yet.
+    AMSG_INLINE ::std::size_t read_remain() const
+    {
+      return this->m_read_tail_ptr - this->m_read_ptr;
+    }
+
+    /// bytes read (or skipped) since construction.
+    AMSG_INLINE ::std::size_t read_length() const
+    {
+      return this->m_offset + (this->m_read_ptr - &this->m_window[0]);
+    }
+
+    AMSG_INLINE ::std::size_t read(char * buffer, ::std::size_t len)
+    {
+      ::std::size_t done = 0;
+      for (;;)
+      {
+        ::std::size_t n = read_remain() < len - done ? read_remain() : len - done;
+        ::std::memcpy(buffer + done, this->m_read_ptr, n);
+        this->m_read_ptr += n;
+        done += n;
+        if (done == len)
+        {
+          return done;
+        }
+        // window is empty, large rest goes straight to caller's buffer.
+        if (len - done >= capacity() && !this->m_eof)
+        {
+          ::std::size_t got = this->m_refill((unsigned char *)buffer + done, len - done);
+          this->m_offset += got;
+          done += got;
+          this->m_eof = got == 0;
+          continue;
+        }
+        if (!fill(1))
+        {
+          this->m_status = read_overflow;
+          return done;
+        }
+      }
+    }
+
+    AMSG_INLINE void skip_read(::std::size_t len)
+    {
+      while (len > read_remain())
+      {
+        len -= read_remain();
+        this->m_read_ptr = this->m_read_tail_ptr;
+        if (!fill(1))
+        {
+          this->m_status = read_overflow;
+          return;
+        }
+      }
+      this->m_read_ptr += len;
+    }
+
+    /// make len bytes at read position contiguous in window and return them, not read yet.
+    /// 0 if len is over capacity or source ends before. valid until window refills.
+    AMSG_INLINE unsigned char const* fetch(::std::size_t len)
+    {
+      if (len > read_remain() && !fill(len))
+      {
+        return 0;
+      }
+      return this->m_read_ptr;
+    }
+
+  private:
+    input_buffer(const input_buffer&);
+    input_buffer& operator = (const input_buffer&);
+
+    /// move unread bytes to window head and refill until len bytes are there.
+    bool fill(::std::size_t len)
+    {
+      if (len > capacity())
+      {
+        return false;
+      }
+      unsigned char * head = &this->m_window[0];
+      ::std::size_t remain = read_remain();
+      this->m_offset += this->m_read_ptr - head;
+      ::std::memmove(head, this->m_read_ptr, remain);
+      this->m_read_ptr = head;
+      this->m_read_tail_ptr = head + remain;
+      while (remain < len && !this->m_eof)
+      {
+        ::std::size_t got = this->m_refill(head + remain, capacity() - remain);
+        this->m_eof = got == 0;
+        remain += got;
+        this->m_read_tail_ptr = head + remain;
+      }
+      return remain >= len;
+    }
+
+    refill_type m_refill;
+    ::std::vector<unsigned char> m_window;
+    unsigned char const* m_read_ptr;
+    unsigned char const* m_read_tail_ptr;
+    ::std::size_t m_offset;
+    int m_status;
+    bool m_eof;
+    mutable ::std::string m_error_info;
+  };
+
+#ifndef _WIN32
+  /// refill from a file descriptor, retried on EINTR, end of file or error ends input.
+  struct fd_refill
+  {
+    int fd;
+
+    explicit fd_refill(int descriptor)
+      : fd(descriptor)
+    {
+    }
+
+    ::std::size_t operator()(unsigned char * buffer, ::std::size_t len) const
+    {
+      for (;;)
+      {
+        ssize_t got = ::read(this->fd, buffer, len);
+        if (got >= 0)
+        {
+          return (::std::size_t)got;
+        }
+        if (errno != EINTR)
+        {
+          return 0;
+        }
+      }
+    }
+  };
+#endif
+
+  /// struct which fits in window is brought in at once, so bytes views of its members stay valid
+  /// together and its members are read without refill.
+  AMSG_INLINE void read_ahead(input_buffer& stream, ::std::size_t offset, uint32_t len_tag)
+  {
+    ::std::size_t read_len = stream.read_length() - offset;
+    if (len_tag > read_len && len_tag - read_len <= stream.capacity())
+    {
+      stream.fetch(len_tag - read_len);
+    }
+  }
+
+  /// view points into window of stream, valid until it refills. longer than window is overflow.
+  template<typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<is_bytes_view<value_type>::value, void>::type
+    read(input_buffer& stream, value_type& value, uint32_t max = 0)
+  {
+    uint32_t len = 0;
+    read(stream, len);
+    if (stream.error())
+    {
+      return;
+    }
+    if (max > 0 && max < len)
+    {
+      stream.set_error_code(sequence_length_overflow);
+      return;
+    }
+    unsigned char const* read_ptr = stream.fetch(len);
+    if (read_ptr == 0)
+    {
+      stream.set_error_code(stream_buffer_overflow);
+      return;
+    }
+    stream.skip_read(len);
+    value = value_type((char const*)read_ptr, len);
+  }
+}
+
+#endif
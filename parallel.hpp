@@ -0,0 +1,276 @@
+///
+/// Copyright (c) 2012 - 2015 Ning Ding (lordoffox@gmail.com)
+///
+/// Distributed under the Boost Software License, Version 1.0. (See accompanying
+/// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+///
+/// See https://github.com/lordoffox/amsg for latest version.
+///
+
+#ifndef AMSG_PARALLEL_HPP
+#define AMSG_PARALLEL_HPP
+
+#include "zerocopy.hpp"
+#include <atomic>
+#include <thread>
+
+namespace amsg
+{
+  /// runs task(0) .. task(count - 1) on its own threads, returns when all are done.
+  /// any executor given to parallel_write does the same by executor(count, task),
+  /// a thread pool joins by running tasks and waiting for them.
+  class thread_executor
+  {
+  public:
+    explicit thread_executor(unsigned int threads = ::std::thread::hardware_concurrency())
+      : m_threads(threads > 0 ? threads : 1)
+    {
+    }
+
+    AMSG_INLINE unsigned int threads() const
+    {
+      return m_threads;
+    }
+
+    template<typename task_ty>
+    void operator()(::std::size_t count, const task_ty& task) const
+    {
+      ::std::atomic< ::std::size_t> next(0);
+      auto run = [&]()
+      {
+        for (::std::size_t i = next++; i < count; i = next++)
+        {
+          task(i);
+        }
+      };
+      ::std::size_t workers_count = count < m_threads ? count : m_threads;
+      ::std::vector< ::std::thread> workers;
+      workers.reserve(workers_count);
+      for (::std::size_t i = 1; i < workers_count; ++i)
+      {
+        workers.emplace_back(run);
+      }
+      run();
+      for (::std::size_t i = 0; i < workers.size(); ++i)
+      {
+        workers[i].join();
+      }
+    }
+
+  private:
+    unsigned int m_threads;
+  };
+
+  /// elements [begin, end) of a sequence, encoded or decoded by one task at offset.
+  struct parallel_slice
+  {
+    ::std::size_t begin;
+    ::std::size_t end;
+    ::std::size_t offset;
+    ::std::size_t size;
+    ::std::size_t failed;
+    error_code_t error_code;
+    uint64_t decoded_elements;
+    uint64_t decoded_bytes;
+  };
+
+  /// elements per task at least, and tasks at most.
+  enum
+  {
+    parallel_grain = 256,
+    parallel_max_slices = 256
+  };
+
+  AMSG_INLINE void make_parallel_slices(::std::vector<parallel_slice>& slices, ::std::size_t len)
+  {
+    ::std::size_t count = (len + parallel_grain - 1) / parallel_grain;
+    if (count > parallel_max_slices)
+    {
+      count = parallel_max_slices;
+    }
+    slices.resize(count);
+    for (::std::size_t i = 0; i < count; ++i)
+    {
+      parallel_slice& slice = slices[i];
+      slice.begin = len * i / count;
+      slice.end = len * (i + 1) / count;
+      slice.offset = 0;
+      slice.size = 0;
+      slice.failed = 0;
+      slice.error_code = success;
+      slice.decoded_elements = 0;
+      slice.decoded_bytes = 0;
+    }
+  }
+
+  /// same as write(store_data, value), stores without a contiguous write region are written serially.
+  template<typename store_ty, typename value_type, typename alloc_ty, typename executor_ty>
+  AMSG_INLINE void parallel_write(store_ty& store_data, const ::std::vector<value_type, alloc_ty>& value, executor_ty&)
+  {
+    write(store_data, value);
+  }
+
+  /// elements are sized by slices in parallel, then each slice is encoded straight into its
+  /// place in stream's write region. output is byte identical to write(stream, value).
+  template<typename value_type, typename alloc_ty, typename executor_ty>
+  void parallel_write(zero_copy_buffer& stream, const ::std::vector<value_type, alloc_ty>& value, executor_ty& executor)
+  {
+    // gather keeps large bytes out of write region in the order they are written.
+    if (stream.gather() || value.size() < 2 * parallel_grain)
+    {
+      write(stream, value);
+      return;
+    }
+    ::std::vector<parallel_slice> slices;
+    make_parallel_slices(slices, value.size());
+    executor(slices.size(), [&](::std::size_t s)
+    {
+      parallel_slice& slice = slices[s];
+      for (::std::size_t i = slice.begin; i < slice.end; ++i)
+      {
+        slice.size += size_of(value[i]);
+      }
+    });
+    ::std::size_t total = 0;
+    for (::std::size_t s = 0; s < slices.size(); ++s)
+    {
+      slices[s].offset = total;
+      total += slices[s].size;
+    }
+    // count and elements are reserved together, a failure leaves stream as it was.
+    uint32_t len = (uint32_t)value.size();
+    ::std::size_t len_size = size_of(len);
+    unsigned char * base = stream.reserve_write(len_size + total);
+    if (base == 0)
+    {
+      stream.set_error_code(stream_buffer_overflow);
+      return;
+    }
+    zero_copy_buffer len_stream;
+    len_stream.set_write(base, len_size);
+    write(len_stream, len);
+    base += len_size;
+    executor(slices.size(), [&](::std::size_t s)
+    {
+      parallel_slice& slice = slices[s];
+      zero_copy_buffer slice_stream;
+      slice_stream.set_write(base + slice.offset, slice.size);
+      for (::std::size_t i = slice.begin; i < slice.end; ++i)
+      {
+        write(slice_stream, value[i]);
+        if (slice_stream.error())
+        {
+          slice.failed = i;
+          slice.error_code = slice_stream.error_code();
+          return;
+        }
+      }
+    });
+    for (::std::size_t s = 0; s < slices.size(); ++s)
+    {
+      if (slices[s].error_code != success)
+      {
+        stream.set_error_code(slices[s].error_code);
+        AMSG_ERROR_INDEX(stream, (uint32_t)slices[s].failed);
+        return;
+      }
+    }
+    stream.advance_write(len_size + total);
+  }
+
+  /// same as read(store_data, value), stores other than zero_copy_buffer are read serially.
+  template<typename store_ty, typename value_type, typename alloc_ty, typename executor_ty>
+  AMSG_INLINE void parallel_read(store_ty& store_data, ::std::vector<value_type, alloc_ty>& value, executor_ty&)
+  {
+    read(store_data, value);
+  }
+
+  /// AMSG struct elements are found by scanning their length prefixes, then slices are decoded
+  /// in parallel into the vector sized once. on any failure elements are decoded again serially,
+  /// so errors and error path are same as read(stream, value).
+  template<typename value_type, typename alloc_ty, typename executor_ty>
+  typename ::std::enable_if<struct_traits<value_type>::value, void>::type
+    parallel_read(zero_copy_buffer& stream, ::std::vector<value_type, alloc_ty>& value, executor_ty& executor)
+  {
+    uint32_t len = 0;
+    read(stream, len);
+    if (stream.error())
+    {
+      return;
+    }
+    if (!check_read_length(stream, len, min_size_of<value_type>()) ||
+      !stream.charge_decode(len, (uint64_t)len * sizeof(value_type)))
+    {
+      return;
+    }
+    // budget is shared by all elements, slices could not tell where it runs out.
+    if (len < 2 * parallel_grain || stream.decode_limited())
+    {
+      read_sequence_elements(stream, value, len);
+      return;
+    }
+    ::std::vector<parallel_slice> slices;
+    make_parallel_slices(slices, len);
+    zero_copy_buffer scan;
+    scan.set_read(stream.read_ptr(), stream.read_remain());
+    for (::std::size_t s = 0; s < slices.size(); ++s)
+    {
+      parallel_slice& slice = slices[s];
+      slice.offset = scan.read_length();
+      for (::std::size_t i = slice.begin; i < slice.end; ++i)
+      {
+        value_type * elem_value = nullptr;
+        skip_read(scan, elem_value);
+        if (scan.error())
+        {
+          read_sequence_elements(stream, value, len);
+          return;
+        }
+      }
+      slice.size = scan.read_length() - slice.offset;
+    }
+    ::std::size_t total = scan.read_length();
+    value.resize(len);
+    unsigned char const* base = stream.read_ptr();
+    executor(slices.size(), [&](::std::size_t s)
+    {
+      parallel_slice& slice = slices[s];
+      zero_copy_buffer slice_stream;
+      slice_stream.set_read(base + slice.offset, slice.size);
+      slice_stream.set_read_padded(stream.read_padded() || stream.read_remain() - slice.offset - slice.size >= 8);
+      for (::std::size_t i = slice.begin; i < slice.end; ++i)
+      {
+        // an element must end where its length prefix says, as the scan assumed.
+        zero_copy_buffer prefix;
+        prefix.set_read(slice_stream.read_ptr(), slice_stream.read_remain());
+        uint32_t len_tag = 0;
+        read(prefix, len_tag);
+        ::std::size_t offset = slice_stream.read_length();
+        read(slice_stream, value[i]);
+        if (slice_stream.error() || slice_stream.read_length() - offset != len_tag)
+        {
+          slice.error_code = slice_stream.error() ? slice_stream.error_code() : stream_buffer_overflow;
+          return;
+        }
+      }
+      slice.decoded_elements = slice_stream.decoded_elements();
+      slice.decoded_bytes = slice_stream.decoded_bytes();
+    });
+    uint64_t elements = 0;
+    uint64_t bytes = 0;
+    for (::std::size_t s = 0; s < slices.size(); ++s)
+    {
+      if (slices[s].error_code != success)
+      {
+        read_sequence_elements(stream, value, len);
+        return;
+      }
+      elements += slices[s].decoded_elements;
+      bytes += slices[s].decoded_bytes;
+    }
+    stream.skip_read(total);
+    stream.charge_decode(elements, bytes);
+  }
+}
+
+#endif
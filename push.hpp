@@ -0,0 +1,505 @@
+///
+/// Copyright (c) 2012 - 2015 Ning Ding (lordoffox@gmail.com)
+///
+/// Distributed under the Boost Software License, Version 1.0. (See accompanying
+/// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+///
+/// See https://github.com/lordoffox/amsg for latest version.
+///
+
+#ifndef AMSG_PUSH_HPP
+#define AMSG_PUSH_HPP
+
+#include "zerocopy.hpp"
+
+namespace amsg
+{
+  class push_context;
+
+  /// one AMSG struct or vector being decoded, resumed where it stopped.
+  struct push_frame
+  {
+    int (*step)(push_context& ctx, ::std::size_t frame);
+    void * object;
+    /// member name in parent, 0 for vector elements and message itself.
+    const char * name;
+    /// where innermost struct ends in message.
+    ::std::size_t end;
+    uint64_t tag;
+    uint32_t index;
+    uint32_t count;
+    bool started;
+    bool is_struct;
+  };
+
+  /// state machine of push_parser: a stack of frames over bytes fed so far.
+  /// bytes of a message are taken straight from caller, only an unfinished field is kept.
+  class push_context
+  {
+  public:
+    push_context()
+      : m_data(0)
+      , m_data_length(0)
+      , m_base(0)
+      , m_pos(0)
+      , m_wait(0)
+      , m_received(0)
+      , m_end(unknown_end)
+      , m_status(push_need_more)
+    {
+    }
+
+    AMSG_INLINE push_status status() const
+    {
+      return (push_status)this->m_status;
+    }
+
+    AMSG_INLINE bool done() const
+    {
+      return this->m_status == push_done;
+    }
+
+    AMSG_INLINE bool need_more() const
+    {
+      return this->m_status == push_need_more;
+    }
+
+    AMSG_INLINE bool failed() const
+    {
+      return this->m_status == push_failed;
+    }
+
+    AMSG_INLINE error_code_t error_code() const
+    {
+      return this->m_store.error_code();
+    }
+
+    /// error field path as text, built when asked.
+    AMSG_INLINE const ::std::string& info() const
+    {
+      this->m_error_info.clear();
+#ifndef AMSG_NO_ERROR_PATH
+      this->m_store.error_path().append_to(this->m_error_info);
+#endif
+      return this->m_error_info;
+    }
+
+    AMSG_INLINE void set_decode_limits(const decode_limits& limits)
+    {
+      this->m_limits = limits;
+      this->m_store.set_decode_limits(limits);
+    }
+
+    /// bytes of current message taken so far.
+    AMSG_INLINE ::std::size_t read_length() const
+    {
+      return this->m_received;
+    }
+
+    /// bytes kept for an unfinished field.
+    AMSG_INLINE ::std::size_t pending() const
+    {
+      return this->m_pending.size();
+    }
+
+    /// take bytes of current message from data, returns how many, rest belongs to next message.
+    /// check status after: need_more, done (call reset for next message) or failed.
+    ::std::size_t feed(const void * data, ::std::size_t len)
+    {
+      unsigned char const* ptr = (unsigned char const*)data;
+      ::std::size_t used = 0;
+      while (used < len && this->m_status == push_need_more)
+      {
+        ::std::size_t take = len - used;
+        if (this->m_pending.empty())
+        {
+          // parse right in caller's bytes, keep what is left of an unfinished field.
+          if (this->m_end != unknown_end && take > this->m_end - this->m_received)
+          {
+            take = this->m_end - this->m_received;
+          }
+          set_data(ptr + used, take, this->m_received);
+          run();
+          ::std::size_t parsed = this->m_pos - this->m_received;
+          if (this->m_end != unknown_end && take > this->m_end - this->m_received)
+          {
+            take = this->m_end - this->m_received;
+          }
+          if (this->m_status == push_need_more)
+          {
+            this->m_pending.assign(ptr + used + parsed, ptr + used + take);
+          }
+          else
+          {
+            take = parsed;
+          }
+        }
+        else
+        {
+          // until message end is known from its length prefix, a byte at a time not to take next one's.
+          ::std::size_t limit = this->m_end == unknown_end ? 1 : this->m_end - this->m_received;
+          take = take < limit ? take : limit;
+          ::std::size_t pending_base = this->m_received - this->m_pending.size();
+          this->m_pending.insert(this->m_pending.end(), ptr + used, ptr + used + take);
+          set_data(&this->m_pending[0], this->m_pending.size(), pending_base);
+          run();
+          this->m_pending.erase(this->m_pending.begin(), this->m_pending.begin() + (this->m_pos - pending_base));
+        }
+        this->m_received += take;
+        used += take;
+      }
+      this->m_data = 0;
+      this->m_data_length = 0;
+      return used;
+    }
+
+    // used by frame steps and push_member overloads.
+
+    AMSG_INLINE push_frame& frame(::std::size_t index)
+    {
+      return this->m_frames[index];
+    }
+
+    AMSG_INLINE ::std::size_t top() const
+    {
+      return this->m_frames.size() - 1;
+    }
+
+    AMSG_INLINE basic_store& store()
+    {
+      return this->m_store;
+    }
+
+    /// decode a field whole by a bounded zero_copy_buffer, need more if it ran out of fed bytes.
+    template<typename value_type>
+    int read_leaf(value_type&& value, const char * name)
+    {
+      ::std::size_t limit = bound() - this->m_pos;
+      zero_copy_buffer reader;
+      reader.set_read(this->m_data + (this->m_pos - this->m_base), limit);
+      reader.set_decode_limits(this->m_limits);
+      read(reader, value);
+      if (!reader.error())
+      {
+        this->m_pos += reader.read_length();
+        if (!this->m_store.charge_decode(reader.decoded_elements(), reader.decoded_bytes()))
+        {
+          return fail(name);
+        }
+        return push_done;
+      }
+      if (reader.error_code() == stream_buffer_overflow && more_coming(limit))
+      {
+        return push_need_more;
+      }
+      this->m_store.set_error_code(reader.error_code());
+      // where in the field it failed, as read would have it.
+      AMSG_ERROR_PATH(this->m_store, reader);
+      return fail(name);
+    }
+
+    template<typename value_type>
+    int push_struct(value_type& value, const char * name)
+    {
+      push_frame frame = { &struct_step<value_type>, ::std::addressof(value), name, enclosing_end(), 0, 0, 0, false, true };
+      this->m_frames.push_back(frame);
+      return push_done;
+    }
+
+    template<typename value_type, typename alloc_ty>
+    int push_sequence(::std::vector<value_type, alloc_ty>& value, const char * name)
+    {
+      push_frame frame = { &sequence_step<value_type, alloc_ty>, ::std::addressof(value), name, enclosing_end(), 0, 0, 0, false, false };
+      this->m_frames.push_back(frame);
+      return push_done;
+    }
+
+  protected:
+    /// start over for a message decoded into root.
+    template<typename value_type>
+    void start(value_type& root)
+    {
+      this->m_frames.clear();
+      this->m_pending.clear();
+      this->m_store.clear();
+      this->m_store.set_decode_limits(this->m_limits);
+      this->m_pos = 0;
+      this->m_base = 0;
+      this->m_wait = 0;
+      this->m_received = 0;
+      this->m_end = unknown_end;
+      this->m_status = push_need_more;
+      push_struct(root, 0);
+    }
+
+  private:
+    static const ::std::size_t unknown_end = ~(::std::size_t)0;
+
+    push_context(const push_context&);
+    push_context& operator = (const push_context&);
+
+    AMSG_INLINE void set_data(unsigned char const* data, ::std::size_t length, ::std::size_t base)
+    {
+      this->m_data = data;
+      this->m_data_length = length;
+      this->m_base = base;
+    }
+
+    AMSG_INLINE ::std::size_t enclosing_end() const
+    {
+      return this->m_frames.empty() ? unknown_end : this->m_frames.back().end;
+    }
+
+    /// fed bytes end, or innermost struct end if it is before.
+    AMSG_INLINE ::std::size_t bound() const
+    {
+      ::std::size_t end = this->m_base + this->m_data_length;
+      if (!this->m_frames.empty() && this->m_frames.back().end < end)
+      {
+        end = this->m_frames.back().end;
+      }
+      return end;
+    }
+
+    /// a field of limit bytes so far did not fit: wait if its struct is not all fed yet,
+    /// for twice as many bytes so a long field is not decoded over and over.
+    AMSG_INLINE bool more_coming(::std::size_t limit)
+    {
+      ::std::size_t end = enclosing_end();
+      if (this->m_pos + limit >= end)
+      {
+        return false;
+      }
+      // message end is not known before its length prefix, next byte may belong to next message.
+      ::std::size_t wait = end == unknown_end ? this->m_pos + limit + 1 : this->m_pos + limit * 2 + 16;
+      this->m_wait = wait < end ? wait : end;
+      return true;
+    }
+
+    /// record path of a failure from innermost frame out.
+    int fail(const char * name)
+    {
+      if (this->m_store.error_code() == success)
+      {
+        this->m_store.set_error_code(stream_buffer_overflow);
+      }
+      if (name)
+      {
+        AMSG_ERROR_MEMBER(this->m_store, name);
+      }
+      for (::std::size_t i = this->m_frames.size(); i > 0; --i)
+      {
+        push_frame& frame = this->m_frames[i - 1];
+        if (!frame.is_struct && frame.index > 0)
+        {
+          AMSG_ERROR_INDEX(this->m_store, frame.index - 1);
+        }
+        if (frame.name)
+        {
+          AMSG_ERROR_MEMBER(this->m_store, frame.name);
+        }
+      }
+      return push_failed;
+    }
+
+    void run()
+    {
+      while (!this->m_frames.empty())
+      {
+        if (this->m_base + this->m_data_length < this->m_wait)
+        {
+          return;
+        }
+        ::std::size_t index = this->m_frames.size() - 1;
+        int status = this->m_frames[index].step(*this, index);
+        if (status == push_need_more)
+        {
+          return;
+        }
+        if (status == push_failed)
+        {
+          this->m_status = push_failed;
+          return;
+        }
+        this->m_wait = 0;
+      }
+      this->m_status = push_done;
+    }
+
+    /// skip to end of struct (members unknown to this side), false if not fed yet.
+    AMSG_INLINE bool skip_to(::std::size_t end)
+    {
+      ::std::size_t fed = this->m_base + this->m_data_length;
+      this->m_pos = end < fed ? end : fed;
+      return this->m_pos == end;
+    }
+
+    template<typename value_type>
+    static int struct_step(push_context& ctx, ::std::size_t index)
+    {
+      push_frame* frame = &ctx.frame(index);
+      value_type& value = *(value_type*)frame->object;
+      if (!frame->started)
+      {
+        ::std::size_t limit = ctx.bound() - ctx.m_pos;
+        zero_copy_buffer reader;
+        reader.set_read(ctx.m_data + (ctx.m_pos - ctx.m_base), limit);
+        uint32_t len_tag = 0;
+        uint64_t tag = 0;
+        read(reader, len_tag);
+        read(reader, tag);
+        if (reader.error())
+        {
+          if (reader.error_code() == stream_buffer_overflow && ctx.more_coming(limit))
+          {
+            return push_need_more;
+          }
+          ctx.m_store.set_error_code(reader.error_code());
+          return ctx.fail(0);
+        }
+        if (len_tag < reader.read_length() || ctx.m_pos + len_tag > frame->end)
+        {
+          return ctx.fail(0);
+        }
+        if (!ctx.m_store.enter_struct())
+        {
+          return ctx.fail(0);
+        }
+        frame->end = ctx.m_pos + len_tag;
+        frame->tag = tag;
+        frame->started = true;
+        ctx.m_pos += reader.read_length();
+        if (index == 0)
+        {
+          ctx.m_end = frame->end;
+        }
+      }
+      while (frame->index < struct_traits<value_type>::member_count)
+      {
+        uint32_t i = frame->index++;
+        if ((frame->tag & (1ULL << i)) == 0)
+        {
+          continue;
+        }
+        int status = struct_traits<value_type>::push_member(ctx, value, i);
+        frame = &ctx.frame(index);
+        if (status == push_need_more)
+        {
+          frame->index = i;
+          return status;
+        }
+        if (status == push_failed || ctx.top() != index)
+        {
+          return status;
+        }
+      }
+      if (!ctx.skip_to(frame->end))
+      {
+        return push_need_more;
+      }
+      ctx.m_store.leave_struct();
+      ctx.m_frames.pop_back();
+      return push_done;
+    }
+
+    template<typename value_type, typename alloc_ty>
+    static int sequence_step(push_context& ctx, ::std::size_t index)
+    {
+      push_frame* frame = &ctx.frame(index);
+      ::std::vector<value_type, alloc_ty>& value = *(::std::vector<value_type, alloc_ty>*)frame->object;
+      if (!frame->started)
+      {
+        ::std::size_t limit = ctx.bound() - ctx.m_pos;
+        zero_copy_buffer reader;
+        reader.set_read(ctx.m_data + (ctx.m_pos - ctx.m_base), limit);
+        uint32_t len = 0;
+        read(reader, len);
+        if (reader.error())
+        {
+          if (reader.error_code() == stream_buffer_overflow && ctx.more_coming(limit))
+          {
+            return push_need_more;
+          }
+          ctx.m_store.set_error_code(reader.error_code());
+          return ctx.fail(0);
+        }
+        ctx.m_pos += reader.read_length();
+        if ((uint64_t)len * min_size_of<value_type>() > frame->end - ctx.m_pos)
+        {
+          return ctx.fail(0);
+        }
+        if (!ctx.m_store.charge_decode(len, (uint64_t)len * sizeof(value_type)))
+        {
+          return ctx.fail(0);
+        }
+        value.resize(len);
+        frame->count = len;
+        frame->started = true;
+      }
+      while (frame->index < frame->count)
+      {
+        uint32_t i = frame->index++;
+        int status = push_member(ctx, value[i], 0);
+        frame = &ctx.frame(index);
+        if (status == push_need_more)
+        {
+          frame->index = i;
+          return status;
+        }
+        if (status == push_failed || ctx.top() != index)
+        {
+          return status;
+        }
+      }
+      ctx.m_frames.pop_back();
+      return push_done;
+    }
+
+    unsigned char const* m_data;
+    ::std::size_t m_data_length;
+    /// message offset of m_data[0].
+    ::std::size_t m_base;
+    /// message offset of next field.
+    ::std::size_t m_pos;
+    /// do not retry before fed bytes reach it.
+    ::std::size_t m_wait;
+    ::std::size_t m_received;
+    ::std::size_t m_end;
+    int m_status;
+    ::std::vector<push_frame> m_frames;
+    ::std::vector<unsigned char> m_pending;
+    basic_store m_store;
+    decode_limits m_limits;
+    mutable ::std::string m_error_info;
+  };
+
+  /// resumable decoder for non-blocking input: feed bytes as they arrive, a message is
+  /// decoded as far as its fields are in, nested AMSG structs and vectors included.
+  /// members must own their data (no bytes_view), fed bytes are not kept.
+  template<typename value_type>
+  class push_parser : public push_context
+  {
+  public:
+    push_parser()
+      : m_value()
+    {
+      reset();
+    }
+
+    /// next message is decoded into value() again, in place as read does.
+    AMSG_INLINE void reset()
+    {
+      this->start(this->m_value);
+    }
+
+    AMSG_INLINE value_type& value()
+    {
+      return this->m_value;
+    }
+
+  private:
+    value_type m_value;
+  };
+}
+
+#endif
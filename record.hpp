@@ -0,0 +1,248 @@
+///
+/// Copyright (c) 2012 - 2015 Ning Ding (lordoffox@gmail.com)
+///
+/// Distributed under the Boost Software License, Version 1.0. (See accompanying
+/// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+///
+/// See https://github.com/lordoffox/amsg for latest version.
+///
+
+#ifndef AMSG_RECORD_HPP
+#define AMSG_RECORD_HPP
+
+#include "zerocopy.hpp"
+
+namespace amsg
+{
+  /// a record is one AMSG struct as amsg::write puts it, framed by its own length prefix.
+  /// reads record length from first bytes of data: 1 if it is known, 0 if length prefix
+  /// is not all there yet, -1 (error_code set) if it is broken.
+  AMSG_INLINE int record_length(unsigned char const* data, ::std::size_t len, uint32_t& record_len, error_code_t& error_code)
+  {
+    zero_copy_buffer reader;
+    reader.set_read(data, len < 5 ? len : 5);
+    read(reader, record_len);
+    if (reader.error())
+    {
+      if (reader.error_code() == stream_buffer_overflow && len < 5)
+      {
+        return 0;
+      }
+      error_code = reader.error_code();
+      return -1;
+    }
+    // tag follows length prefix in every struct.
+    if (record_len < reader.read_length() + 1)
+    {
+      error_code = stream_buffer_overflow;
+      return -1;
+    }
+    return 1;
+  }
+
+  /// byte ring for a stream of records: received bytes go in at write_ptr, whole records come out
+  /// in batches as spans ready for zero_copy_buffer::set_read. a record wrapping around ring end
+  /// is made contiguous in a side buffer, at most one per batch.
+  class record_ring
+  {
+  public:
+    /// capacity is rounded up to a power of 2, it is the largest record too.
+    explicit record_ring(::std::size_t capacity)
+      : m_mask(0)
+      , m_read(0)
+      , m_batch(0)
+      , m_write(0)
+      , m_error_code(success)
+    {
+      ::std::size_t size = 16;
+      while (size < capacity)
+      {
+        size <<= 1;
+      }
+      this->m_ring.resize(size);
+      this->m_mask = size - 1;
+    }
+
+    AMSG_INLINE ::std::size_t capacity() const
+    {
+      return this->m_ring.size();
+    }
+
+    /// bytes in ring, released ones not counted.
+    AMSG_INLINE ::std::size_t size() const
+    {
+      return (::std::size_t)(this->m_write - this->m_read);
+    }
+
+    AMSG_INLINE error_code_t error_code() const
+    {
+      return this->m_error_code;
+    }
+
+    AMSG_INLINE bool error() const
+    {
+      return this->m_error_code != success;
+    }
+
+    /// contiguous free room to receive into, commit what was put there.
+    AMSG_INLINE unsigned char * write_ptr(::std::size_t& room)
+    {
+      ::std::size_t index = (::std::size_t)(this->m_write & this->m_mask);
+      ::std::size_t free_size = capacity() - size();
+      room = capacity() - index < free_size ? capacity() - index : free_size;
+      return &this->m_ring[index];
+    }
+
+    AMSG_INLINE void commit(::std::size_t len)
+    {
+      this->m_write += len;
+    }
+
+    /// copy bytes in, false if there is no room for all of them.
+    bool append(const void * data, ::std::size_t len)
+    {
+      if (len > capacity() - size())
+      {
+        return false;
+      }
+      unsigned char const* ptr = (unsigned char const*)data;
+      while (len > 0)
+      {
+        ::std::size_t room = 0;
+        unsigned char * dest = write_ptr(room);
+        ::std::size_t n = room < len ? room : len;
+        ::std::memcpy(dest, ptr, n);
+        commit(n);
+        ptr += n;
+        len -= n;
+      }
+      return true;
+    }
+
+    /// encode value as a record, false if there is no room for it (or it fails to encode).
+    template<typename value_type>
+    bool write_record(const value_type& value)
+    {
+      ::std::size_t len = size_of(value);
+      if (len > capacity() - size())
+      {
+        return false;
+      }
+      ::std::size_t room = 0;
+      unsigned char * dest = write_ptr(room);
+      zero_copy_buffer writer;
+      if (room >= len)
+      {
+        writer.set_write(dest, len);
+        write(writer, value);
+        if (writer.error())
+        {
+          return false;
+        }
+        commit(len);
+        return true;
+      }
+      this->m_scratch.resize(len);
+      writer.set_write(&this->m_scratch[0], len);
+      write(writer, value);
+      return !writer.error() && append(&this->m_scratch[0], len);
+    }
+
+    /// up to max whole records after released ones, valid until release or next read_records.
+    /// 0 with error() if a record is broken or larger than capacity, ring must be reset then.
+    ::std::size_t read_records(bytes_view * records, ::std::size_t max)
+    {
+      uint64_t pos = this->m_read;
+      ::std::size_t count = 0;
+      bool wrapped = false;
+      while (count < max && this->m_error_code == success)
+      {
+        ::std::size_t avail = (::std::size_t)(this->m_write - pos);
+        if (avail == 0)
+        {
+          break;
+        }
+        ::std::size_t index = (::std::size_t)(pos & this->m_mask);
+        ::std::size_t contiguous = capacity() - index < avail ? capacity() - index : avail;
+        unsigned char head[5];
+        unsigned char const* data = &this->m_ring[index];
+        if (contiguous < 5 && contiguous < avail)
+        {
+          // length prefix may wrap.
+          contiguous = avail < 5 ? avail : 5;
+          copy_out(pos, head, contiguous);
+          data = head;
+        }
+        uint32_t len = 0;
+        int status = record_length(data, contiguous, len, this->m_error_code);
+        if (status == 0)
+        {
+          break;
+        }
+        if (status < 0 || len > capacity())
+        {
+          if (status > 0)
+          {
+            this->m_error_code = stream_buffer_overflow;
+          }
+          count = 0;
+          break;
+        }
+        if (len > avail)
+        {
+          break;
+        }
+        if (index + len <= capacity())
+        {
+          records[count++] = bytes_view((char const*)&this->m_ring[index], len);
+        }
+        else
+        {
+          if (wrapped)
+          {
+            break;
+          }
+          wrapped = true;
+          this->m_wrapped.resize(len);
+          copy_out(pos, &this->m_wrapped[0], len);
+          records[count++] = bytes_view((char const*)&this->m_wrapped[0], len);
+        }
+        pos += len;
+      }
+      this->m_batch = count > 0 ? pos : this->m_read;
+      return count;
+    }
+
+    /// free bytes of records given by last read_records.
+    AMSG_INLINE void release()
+    {
+      this->m_read = this->m_batch;
+    }
+
+    AMSG_INLINE void reset()
+    {
+      this->m_read = this->m_batch = this->m_write = 0;
+      this->m_error_code = success;
+    }
+
+  private:
+    void copy_out(uint64_t pos, unsigned char * dest, ::std::size_t len) const
+    {
+      ::std::size_t index = (::std::size_t)(pos & this->m_mask);
+      ::std::size_t first = capacity() - index < len ? capacity() - index : len;
+      ::std::memcpy(dest, &this->m_ring[index], first);
+      ::std::memcpy(dest + first, &this->m_ring[0], len - first);
+    }
+
+    ::std::vector<unsigned char> m_ring;
+    ::std::vector<unsigned char> m_scratch;
+    ::std::vector<unsigned char> m_wrapped;
+    ::std::size_t m_mask;
+    uint64_t m_read;
+    uint64_t m_batch;
+    uint64_t m_write;
+    error_code_t m_error_code;
+  };
+}
+
+#endif
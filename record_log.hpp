@@ -0,0 +1,449 @@
+///
+/// Copyright (c) 2012 - 2015 Ning Ding (lordoffox@gmail.com)
+///
+/// Distributed under the Boost Software License, Version 1.0. (See accompanying
+/// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+///
+/// See https://github.com/lordoffox/amsg for latest version.
+///
+
+#ifndef AMSG_RECORD_LOG_HPP
+#define AMSG_RECORD_LOG_HPP
+
+#include "record.hpp"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace amsg
+{
+  /// record log file: header (magic, version, index stride), AMSG records back to back, then
+  /// sparse index (offset of every stride-th record, 8 bytes LE each) and trailer (record count,
+  /// index offset, magic). a log not closed has no index, reader rebuilds it by scanning records.
+  enum
+  {
+    record_log_header_size = 16,
+    record_log_trailer_size = 24,
+    record_log_version = 1
+  };
+
+  AMSG_INLINE const char * record_log_magic()
+  {
+    return "AMSGLOG";
+  }
+
+  AMSG_INLINE const char * record_log_index_magic()
+  {
+    return "AMSGIDX";
+  }
+
+  /// appends records to a new log file through a write buffer. false on io error, errno tells.
+  class record_log_writer
+  {
+  public:
+    explicit record_log_writer(::std::size_t buffer_size = 1024 * 1024)
+      : m_fd(-1)
+      , m_stride(0)
+      , m_offset(0)
+      , m_count(0)
+      , m_buffer_size(buffer_size > 64 ? buffer_size : 64)
+    {
+    }
+
+    ~record_log_writer()
+    {
+      close();
+    }
+
+    /// creates (or truncates) path, index has an entry every stride records.
+    bool open(const char * path, uint32_t stride = 1024)
+    {
+      close();
+      this->m_fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (this->m_fd < 0)
+      {
+        return false;
+      }
+      this->m_stride = stride > 0 ? stride : 1;
+      this->m_offset = 0;
+      this->m_count = 0;
+      this->m_index.clear();
+      this->m_buffer.reserve(this->m_buffer_size);
+      this->m_buffer.clear();
+      unsigned char header[record_log_header_size] = { 0 };
+      ::std::memcpy(header, record_log_magic(), 7);
+      uint32_t data = host_to_le((uint32_t)record_log_version);
+      ::std::memcpy(header + 8, &data, 4);
+      data = host_to_le(this->m_stride);
+      ::std::memcpy(header + 12, &data, 4);
+      put(header, record_log_header_size);
+      return true;
+    }
+
+    AMSG_INLINE bool is_open() const
+    {
+      return this->m_fd >= 0;
+    }
+
+    /// records appended.
+    AMSG_INLINE uint64_t count() const
+    {
+      return this->m_count;
+    }
+
+    /// a record larger than buffer size is staged alone, buffer grows to hold it.
+    template<typename value_type>
+    bool append(const value_type& value)
+    {
+      if (this->m_fd < 0)
+      {
+        return false;
+      }
+      ::std::size_t len = size_of(value);
+      if (this->m_buffer.size() + len > this->m_buffer_size && !flush())
+      {
+        return false;
+      }
+      if (this->m_count % this->m_stride == 0)
+      {
+        this->m_index.push_back(this->m_offset);
+      }
+      ::std::size_t size = this->m_buffer.size();
+      this->m_buffer.resize(size + len);
+      zero_copy_buffer writer;
+      writer.set_write(&this->m_buffer[size], len);
+      write(writer, value);
+      if (writer.error())
+      {
+        this->m_buffer.resize(size);
+        if (this->m_count % this->m_stride == 0)
+        {
+          this->m_index.pop_back();
+        }
+        return false;
+      }
+      this->m_offset += len;
+      ++this->m_count;
+      return true;
+    }
+
+    bool flush()
+    {
+      if (this->m_fd < 0)
+      {
+        return false;
+      }
+      unsigned char const* ptr = this->m_buffer.empty() ? 0 : &this->m_buffer[0];
+      ::std::size_t len = this->m_buffer.size();
+      while (len > 0)
+      {
+        ssize_t done = ::write(this->m_fd, ptr, len);
+        if (done < 0)
+        {
+          if (errno == EINTR)
+          {
+            continue;
+          }
+          // bytes written are not written again by a later flush.
+          this->m_buffer.erase(this->m_buffer.begin(), this->m_buffer.begin() + (this->m_buffer.size() - len));
+          return false;
+        }
+        ptr += done;
+        len -= (::std::size_t)done;
+      }
+      this->m_buffer.clear();
+      return true;
+    }
+
+    /// writes index and trailer, then closes file.
+    bool close()
+    {
+      if (this->m_fd < 0)
+      {
+        return true;
+      }
+      uint64_t index_offset = this->m_offset;
+      for (::std::size_t i = 0; i < this->m_index.size(); ++i)
+      {
+        uint64_t data = host_to_le(this->m_index[i]);
+        put(&data, 8);
+      }
+      unsigned char trailer[record_log_trailer_size] = { 0 };
+      uint64_t data = host_to_le(this->m_count);
+      ::std::memcpy(trailer, &data, 8);
+      data = host_to_le(index_offset);
+      ::std::memcpy(trailer + 8, &data, 8);
+      ::std::memcpy(trailer + 16, record_log_index_magic(), 7);
+      put(trailer, record_log_trailer_size);
+      bool done = flush();
+      done = ::close(this->m_fd) == 0 && done;
+      this->m_fd = -1;
+      return done;
+    }
+
+  private:
+    record_log_writer(const record_log_writer&);
+    record_log_writer& operator = (const record_log_writer&);
+
+    /// bytes other than records, offset counts them too.
+    void put(const void * data, ::std::size_t len)
+    {
+      unsigned char const* ptr = (unsigned char const*)data;
+      this->m_buffer.insert(this->m_buffer.end(), ptr, ptr + len);
+      this->m_offset += len;
+    }
+
+    int m_fd;
+    uint32_t m_stride;
+    uint64_t m_offset;
+    uint64_t m_count;
+    ::std::size_t m_buffer_size;
+    ::std::vector<unsigned char> m_buffer;
+    ::std::vector<uint64_t> m_index;
+  };
+
+  /// maps a log file read only and gives records in place, decoded by zero_copy_buffer
+  /// straight from the mapping. access is hinted sequential, seek goes by sparse index.
+  class record_log
+  {
+  public:
+    record_log()
+      : m_data(0)
+      , m_size(0)
+      , m_end(0)
+      , m_stride(0)
+      , m_count(0)
+      , m_pos(0)
+      , m_record(0)
+      , m_indexed(false)
+    {
+    }
+
+    ~record_log()
+    {
+      close();
+    }
+
+    /// false if file can not be mapped or is not a record log.
+    bool open(const char * path)
+    {
+      close();
+      int fd = ::open(path, O_RDONLY);
+      if (fd < 0)
+      {
+        return false;
+      }
+      struct stat st;
+      if (::fstat(fd, &st) != 0 || st.st_size < record_log_header_size)
+      {
+        ::close(fd);
+        return false;
+      }
+      void * data = ::mmap(0, (::std::size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (data == MAP_FAILED)
+      {
+        return false;
+      }
+      ::madvise(data, (::std::size_t)st.st_size, MADV_SEQUENTIAL);
+      this->m_data = (unsigned char const*)data;
+      this->m_size = (::std::size_t)st.st_size;
+      uint32_t version = 0;
+      ::std::memcpy(&version, this->m_data + 8, 4);
+      ::std::memcpy(&this->m_stride, this->m_data + 12, 4);
+      this->m_stride = le_to_host(this->m_stride);
+      if (::std::memcmp(this->m_data, record_log_magic(), 8) != 0 ||
+        le_to_host(version) != record_log_version || this->m_stride == 0)
+      {
+        close();
+        return false;
+      }
+      if (!load_index())
+      {
+        scan_index();
+      }
+      this->m_pos = record_log_header_size;
+      this->m_record = 0;
+      return true;
+    }
+
+    void close()
+    {
+      if (this->m_data != 0)
+      {
+        ::munmap((void *)this->m_data, this->m_size);
+      }
+      this->m_data = 0;
+      this->m_size = this->m_end = 0;
+      this->m_count = this->m_record = 0;
+      this->m_pos = 0;
+      this->m_indexed = false;
+      this->m_index.clear();
+    }
+
+    AMSG_INLINE bool is_open() const
+    {
+      return this->m_data != 0;
+    }
+
+    /// whole records in log.
+    AMSG_INLINE uint64_t count() const
+    {
+      return this->m_count;
+    }
+
+    /// number of record next gives.
+    AMSG_INLINE uint64_t position() const
+    {
+      return this->m_record;
+    }
+
+    /// false if index was rebuilt by scanning, log was not closed by its writer.
+    AMSG_INLINE bool indexed() const
+    {
+      return this->m_indexed;
+    }
+
+    /// sets reader to next record, false at end (or where index points to no record).
+    AMSG_INLINE bool next(zero_copy_buffer& reader)
+    {
+      uint32_t len = this->m_record < this->m_count ? record_at(this->m_pos) : 0;
+      if (len == 0)
+      {
+        return false;
+      }
+      reader.set_read(this->m_data + this->m_pos, len);
+      this->m_pos += len;
+      ++this->m_record;
+      return true;
+    }
+
+    /// next gives record number n then, false if n is past end.
+    bool seek(uint64_t n)
+    {
+      if (n > this->m_count)
+      {
+        return false;
+      }
+      if (n == this->m_count)
+      {
+        this->m_pos = this->m_end;
+        this->m_record = n;
+        return true;
+      }
+      ::std::size_t pos = (::std::size_t)this->m_index[(::std::size_t)(n / this->m_stride)];
+      for (uint64_t i = n - n % this->m_stride; i < n; ++i)
+      {
+        uint32_t len = record_at(pos);
+        if (len == 0)
+        {
+          return false;
+        }
+        pos += len;
+      }
+      this->m_pos = pos;
+      this->m_record = n;
+      return true;
+    }
+
+  private:
+    record_log(const record_log&);
+    record_log& operator = (const record_log&);
+
+    /// length of record at pos, 0 if there is no whole record.
+    uint32_t record_at(::std::size_t pos) const
+    {
+      uint32_t len = 0;
+      error_code_t error_code = success;
+      if (pos >= this->m_end ||
+        record_length(this->m_data + pos, this->m_end - pos, len, error_code) <= 0 ||
+        len > this->m_end - pos)
+      {
+        return 0;
+      }
+      return len;
+    }
+
+    /// index written by writer, checked against file size and record region.
+    bool load_index()
+    {
+      if (this->m_size < (::std::size_t)record_log_header_size + record_log_trailer_size)
+      {
+        return false;
+      }
+      unsigned char const* trailer = this->m_data + this->m_size - record_log_trailer_size;
+      uint64_t count, index_offset;
+      ::std::memcpy(&count, trailer, 8);
+      ::std::memcpy(&index_offset, trailer + 8, 8);
+      count = le_to_host(count);
+      index_offset = le_to_host(index_offset);
+      if (::std::memcmp(trailer + 16, record_log_index_magic(), 8) != 0 ||
+        index_offset < record_log_header_size || index_offset > this->m_size - record_log_trailer_size)
+      {
+        return false;
+      }
+      uint64_t entries = (count + this->m_stride - 1) / this->m_stride;
+      if ((this->m_size - record_log_trailer_size - index_offset) / 8 != entries ||
+        (this->m_size - record_log_trailer_size - index_offset) % 8 != 0)
+      {
+        return false;
+      }
+      this->m_index.resize((::std::size_t)entries);
+      if (entries > 0)
+      {
+        ::std::memcpy(&this->m_index[0], this->m_data + index_offset, (::std::size_t)entries * 8);
+      }
+      uint64_t last = record_log_header_size;
+      for (::std::size_t i = 0; i < this->m_index.size(); ++i)
+      {
+        this->m_index[i] = le_to_host(this->m_index[i]);
+        if (this->m_index[i] < last || this->m_index[i] >= index_offset || (i == 0 && this->m_index[i] != last))
+        {
+          this->m_index.clear();
+          return false;
+        }
+        last = this->m_index[i] + 1;
+      }
+      this->m_end = (::std::size_t)index_offset;
+      this->m_count = count;
+      this->m_indexed = true;
+      return true;
+    }
+
+    /// records up to last whole one, a torn tail is left out.
+    void scan_index()
+    {
+      this->m_index.clear();
+      this->m_end = this->m_size;
+      this->m_count = 0;
+      ::std::size_t pos = record_log_header_size;
+      for (uint32_t len = record_at(pos); len > 0; len = record_at(pos))
+      {
+        if (this->m_count % this->m_stride == 0)
+        {
+          this->m_index.push_back(pos);
+        }
+        pos += len;
+        ++this->m_count;
+      }
+      this->m_end = pos;
+    }
+
+    unsigned char const* m_data;
+    ::std::size_t m_size;
+    ::std::size_t m_end;
+    uint32_t m_stride;
+    uint64_t m_count;
+    ::std::size_t m_pos;
+    uint64_t m_record;
+    bool m_indexed;
+    ::std::vector<uint64_t> m_index;
+  };
+}
+#endif
+
+#endif
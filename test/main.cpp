@@ -9,7 +9,17 @@
 
 #include <amsg/all.hpp>
 #include <boost/assert.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/array.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 static std::size_t const test_count = 1;
 
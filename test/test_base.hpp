@@ -22,7 +22,53 @@ struct person
 };
 }
 
+namespace usr
+{
+struct person_view
+{
+  amsg::bytes_view name;
+  boost::int32_t age;
+  bool married;
+};
+}
+
 AMSG(usr::person, (name&smax(30))(age&sfix)(married));
+AMSG(usr::person_view, (name&smax(30))(age&sfix)(married));
+
+namespace usr
+{
+struct team
+{
+  std::string name;
+  person leader;
+  std::vector<person> members;
+};
+}
+
+AMSG(usr::team, (name)(leader)(members));
+
+namespace usr
+{
+struct roster
+{
+  std::vector<person> records;
+  boost::int32_t version;
+};
+}
+
+AMSG(usr::roster, (records&sidx(4))(version));
+
+namespace usr
+{
+struct ledger
+{
+  amsg::arena_string name;
+  amsg::arena_vector<amsg::arena_string> tags;
+  amsg::arena_map<boost::int32_t, amsg::arena_string> notes;
+};
+}
+
+AMSG(usr::ledger, (name)(tags)(notes));
 
 #define ENOUGH_SIZE 4096
 
@@ -38,6 +84,31 @@ public:
     {
       test_base();
       test_common();
+      test_single_pass();
+      test_max_size_of();
+      test_growable();
+      test_gather();
+      test_view();
+      test_fix_sequence();
+      test_batch_integer();
+      test_read_padded();
+      test_integer_limits();
+      test_unchecked_write();
+      test_error_path();
+      test_map_decode();
+      test_length_check();
+      test_decode_limits();
+      test_read_fields();
+      test_lazy_view();
+      test_indexed_sequence();
+      test_parallel_write();
+      test_parallel_read();
+      test_input_buffer();
+      test_push_parser();
+      test_record_ring();
+      test_record_log();
+      test_group_writer();
+      test_arena();
       if (test_count > 1) std::cout << "\r" << i;
     }
     if (test_count > 1) std::cout << std::endl;
@@ -188,5 +259,1419 @@ private:
       std::cerr << "test_common: " << ex.what() << std::endl;
     }
   }
+
+  static void test_single_pass()
+  {
+    try
+    {
+      unsigned char buf[ENOUGH_SIZE];
+      unsigned char single_pass_buf[ENOUGH_SIZE];
+
+      usr::person src;
+      src.name = "lordoffox";
+      src.age = 33;
+      src.married = true;
+
+      amsg::zero_copy_buffer writer;
+      writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(writer, src);
+      BOOST_ASSERT(!writer.bad());
+
+      // single pass write must be same as normal write
+      amsg::zero_copy_buffer single_pass_writer;
+      single_pass_writer.set_write(single_pass_buf, ENOUGH_SIZE);
+      single_pass_writer.set_single_pass(true);
+      amsg::write(single_pass_writer, src);
+      BOOST_ASSERT(!single_pass_writer.bad());
+      BOOST_ASSERT(single_pass_writer.write_length() == amsg::size_of(src));
+      BOOST_ASSERT(std::memcmp(buf, single_pass_buf, writer.write_length()) == 0);
+
+      usr::person des;
+      amsg::zero_copy_buffer reader;
+      reader.set_read(single_pass_buf, single_pass_writer.write_length());
+      amsg::read(reader, des);
+      BOOST_ASSERT(!reader.bad());
+      BOOST_ASSERT(src == des);
+
+      // nested structs, prefixes patched shorter leave gaps squeezed out at end,
+      // or when a region with only 4 bytes slack runs short
+      usr::team team;
+      team.name = "amsg";
+      team.leader = src;
+      team.members.assign(100, src);
+      std::size_t team_size = amsg::size_of(team);
+      std::vector<unsigned char> team_buf(team_size);
+      writer.set_write(&team_buf[0], team_size);
+      amsg::write(writer, team);
+      BOOST_ASSERT(!writer.bad());
+
+      std::size_t slacks[] = { ENOUGH_SIZE, team_size + 4 };
+      for (std::size_t i = 0; i < 2; ++i)
+      {
+        std::vector<unsigned char> single_pass_team_buf(slacks[i]);
+        single_pass_writer.set_write(&single_pass_team_buf[0], slacks[i]);
+        amsg::write(single_pass_writer, team);
+        BOOST_ASSERT(!single_pass_writer.bad());
+        BOOST_ASSERT(single_pass_writer.write_length() == team_size);
+        BOOST_ASSERT(std::memcmp(&team_buf[0], &single_pass_team_buf[0], team_size) == 0);
+      }
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_single_pass: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_max_size_of()
+  {
+    try
+    {
+      // name: 1 + 30, age: 4, married: 1, tag: 1, length: 1
+      static_assert(amsg::max_size_of<usr::person>() == 38, "max_size_of person");
+      unsigned char buf[amsg::max_size_of<usr::person>()];
+
+      usr::person src;
+      src.name = std::string(30, 'x');
+      src.age = -1;
+      src.married = true;
+
+      amsg::zero_copy_buffer writer;
+      writer.set_write(buf, sizeof(buf));
+      amsg::write(writer, src);
+      BOOST_ASSERT(!writer.bad());
+      BOOST_ASSERT(writer.write_length() <= sizeof(buf));
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_max_size_of: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_growable()
+  {
+    try
+    {
+      unsigned char buf[8];
+
+      usr::person src;
+      src.name = "lordoffox";
+      src.age = 33;
+      src.married = true;
+
+      // spill from stack buffer to heap
+      amsg::zero_copy_buffer writer;
+      writer.set_write(buf, sizeof(buf));
+      writer.set_growable(true);
+      amsg::write(writer, src);
+      BOOST_ASSERT(!writer.bad());
+      std::size_t length = writer.write_length();
+      BOOST_ASSERT(length == amsg::size_of(src));
+      unsigned char* data = writer.release_write();
+      BOOST_ASSERT(data != 0);
+      BOOST_ASSERT(writer.write_length() == 0);
+
+      usr::person des;
+      amsg::zero_copy_buffer reader;
+      reader.set_read(data, length);
+      amsg::read(reader, des);
+      std::free(data);
+      BOOST_ASSERT(!reader.bad());
+      BOOST_ASSERT(src == des);
+
+      // copy of a grown buffer has its own region, move hands the region over
+      writer.set_write(buf, sizeof(buf));
+      amsg::write(writer, src);
+      amsg::zero_copy_buffer copy(writer);
+      BOOST_ASSERT(copy.write_length() == length);
+      BOOST_ASSERT(copy.write_data() != writer.write_data());
+      BOOST_ASSERT(std::memcmp(copy.write_data(), writer.write_data(), length) == 0);
+      unsigned char const* region = writer.write_data();
+      amsg::zero_copy_buffer moved(std::move(writer));
+      BOOST_ASSERT(moved.write_data() == region);
+      BOOST_ASSERT(writer.write_length() == 0);
+      copy = std::move(moved);
+      BOOST_ASSERT(copy.write_data() == region);
+      moved = copy;
+      BOOST_ASSERT(moved.write_length() == length && moved.write_data() != region);
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_growable: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_gather()
+  {
+#ifndef _WIN32
+    try
+    {
+      unsigned char buf[ENOUGH_SIZE];
+
+      std::vector<std::string> src;
+      src.push_back(std::string("small"));
+      src.push_back(std::string(ENOUGH_SIZE * 2, 'x'));
+      src.push_back(std::string("small"));
+
+      // large string is referenced, not copied
+      amsg::zero_copy_buffer writer;
+      writer.set_write(buf, ENOUGH_SIZE);
+      writer.set_gather(1024);
+      amsg::write(writer, src);
+      BOOST_ASSERT(!writer.bad());
+      BOOST_ASSERT(writer.gather_length() == amsg::size_of(src));
+      BOOST_ASSERT(writer.write_length() < ENOUGH_SIZE);
+
+      iovec vec[3];
+      BOOST_ASSERT(writer.write_iovec(vec, 3) == 3);
+      BOOST_ASSERT(vec[1].iov_base == src[1].data());
+
+      std::string data;
+      for (std::size_t i = 0; i < 3; ++i)
+      {
+        data.append((char const*)vec[i].iov_base, vec[i].iov_len);
+      }
+
+      std::vector<std::string> des;
+      amsg::zero_copy_buffer reader;
+      reader.set_read(data.data(), data.size());
+      amsg::read(reader, des);
+      BOOST_ASSERT(!reader.bad());
+      BOOST_ASSERT(src == des);
+
+      // single pass length prefix counts a borrowed name larger than write region
+      usr::team big;
+      big.name = std::string(200, 'n');
+      big.leader.name = "lordoffox";
+      big.leader.age = 33;
+      big.leader.married = true;
+      big.members.push_back(big.leader);
+      unsigned char small[64];
+      amsg::zero_copy_buffer big_writer;
+      big_writer.set_write(small, sizeof(small));
+      big_writer.set_gather(128);
+      big_writer.set_single_pass(true);
+      amsg::write(big_writer, big);
+      BOOST_ASSERT(!big_writer.bad());
+      BOOST_ASSERT(big_writer.gather_length() == amsg::size_of(big));
+
+      BOOST_ASSERT(big_writer.write_iovec(vec, 3) == 3);
+      data.clear();
+      for (std::size_t i = 0; i < 3; ++i)
+      {
+        data.append((char const*)vec[i].iov_base, vec[i].iov_len);
+      }
+      usr::team big_des;
+      reader.set_read(data.data(), data.size());
+      amsg::read(reader, big_des);
+      BOOST_ASSERT(!reader.bad());
+      BOOST_ASSERT(big_des.name == big.name);
+      BOOST_ASSERT(big_des.leader == big.leader);
+      BOOST_ASSERT(big_des.members == big.members);
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_gather: " << ex.what() << std::endl;
+    }
+#endif
+  }
+
+  static void test_view()
+  {
+    try
+    {
+      unsigned char buf[ENOUGH_SIZE];
+
+      usr::person src;
+      src.name = "lordoffox";
+      src.age = 33;
+      src.married = true;
+
+      amsg::zero_copy_buffer writer;
+      writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(writer, src);
+      BOOST_ASSERT(!writer.bad());
+
+      // name points into buf
+      usr::person_view des;
+      amsg::zero_copy_buffer reader;
+      reader.set_read(buf, writer.write_length());
+      amsg::read(reader, des);
+      BOOST_ASSERT(!reader.bad());
+      BOOST_ASSERT(des.name == amsg::bytes_view(src.name));
+      BOOST_ASSERT((unsigned char const*)des.name.data() > buf);
+      BOOST_ASSERT((unsigned char const*)des.name.data() < buf + writer.write_length());
+      BOOST_ASSERT(des.age == src.age);
+      BOOST_ASSERT(des.married == src.married);
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_view: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_fix_sequence()
+  {
+    try
+    {
+      unsigned char buf[ENOUGH_SIZE];
+
+      std::vector<boost::int32_t> src(100, boost::int32_t(-1234567));
+      std::vector<boost::int32_t>& src_ref = src;
+
+      amsg::zero_copy_buffer writer;
+      writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(writer, src_ref&amsg::sfix);
+      BOOST_ASSERT(!writer.bad());
+      // length and raw elements
+      BOOST_ASSERT(writer.write_length() == 1 + src.size() * sizeof(boost::int32_t));
+      BOOST_ASSERT(writer.write_length() == amsg::size_of(src_ref&amsg::sfix));
+
+      std::vector<boost::int32_t> des;
+      amsg::zero_copy_buffer reader;
+      reader.set_read(buf, writer.write_length());
+      amsg::read(reader, des&amsg::sfix);
+      BOOST_ASSERT(!reader.bad());
+      BOOST_ASSERT(src == des);
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_fix_sequence: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_batch_integer()
+  {
+    try
+    {
+      unsigned char buf[ENOUGH_SIZE];
+      unsigned char list_buf[ENOUGH_SIZE];
+
+      std::vector<boost::int64_t> src;
+      std::list<boost::int64_t> src_list;
+      for (boost::int64_t i = 0; i < 200; ++i)
+      {
+        boost::int64_t value = (i % 3 == 0) ? i : -i * i * i * 1000;
+        src.push_back(value);
+        src_list.push_back(value);
+      }
+
+      // batch codec has same format as one by one
+      amsg::zero_copy_buffer writer;
+      writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(writer, src);
+      BOOST_ASSERT(!writer.bad());
+
+      amsg::zero_copy_buffer list_writer;
+      list_writer.set_write(list_buf, ENOUGH_SIZE);
+      amsg::write(list_writer, src_list);
+      BOOST_ASSERT(!list_writer.bad());
+      BOOST_ASSERT(writer.write_length() == list_writer.write_length());
+      BOOST_ASSERT(std::memcmp(buf, list_buf, writer.write_length()) == 0);
+
+      std::vector<boost::int64_t> des;
+      amsg::zero_copy_buffer reader;
+      reader.set_read(buf, writer.write_length());
+      amsg::read(reader, des);
+      BOOST_ASSERT(!reader.bad());
+      BOOST_ASSERT(src == des);
+
+      // not enough bytes
+      std::deque<boost::int64_t> des_deque;
+      reader.set_read(buf, writer.write_length() - 1);
+      amsg::read(reader, des_deque);
+      BOOST_ASSERT(reader.bad());
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_batch_integer: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_read_padded()
+  {
+    try
+    {
+      unsigned char buf[ENOUGH_SIZE];
+
+      boost::int64_t src = -1234567890123LL;
+      amsg::zero_copy_buffer writer;
+      writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(writer, src);
+      BOOST_ASSERT(!writer.bad());
+
+      // buf has more than 8 bytes after written length
+      boost::int64_t des = 0;
+      amsg::zero_copy_buffer reader;
+      reader.set_read(buf, writer.write_length());
+      reader.set_read_padded(true);
+      amsg::read(reader, des);
+      BOOST_ASSERT(!reader.bad());
+      BOOST_ASSERT(src == des);
+
+      reader.set_read(buf, writer.write_length() - 1);
+      amsg::read(reader, des);
+      BOOST_ASSERT(reader.bad());
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_read_padded: " << ex.what() << std::endl;
+    }
+  }
+
+  template<typename T>
+  static void test_integer_limit(T src)
+  {
+    unsigned char buf[ENOUGH_SIZE];
+    amsg::zero_copy_buffer writer;
+    writer.set_write(buf, ENOUGH_SIZE);
+    amsg::write(writer, src);
+    BOOST_ASSERT(!writer.bad());
+    BOOST_ASSERT(writer.write_length() == amsg::size_of(src));
+
+    T des = 0;
+    amsg::zero_copy_buffer reader;
+    reader.set_read(buf, writer.write_length());
+    amsg::read(reader, des);
+    BOOST_ASSERT(!reader.bad());
+    BOOST_ASSERT(src == des);
+  }
+
+  static void test_integer_limits()
+  {
+    try
+    {
+      test_integer_limit((std::numeric_limits<boost::int16_t>::min)());
+      test_integer_limit((std::numeric_limits<boost::int32_t>::min)());
+      test_integer_limit((std::numeric_limits<boost::int64_t>::min)());
+      test_integer_limit((std::numeric_limits<boost::uint64_t>::max)());
+      test_integer_limit((boost::int64_t)-0x80);
+      test_integer_limit((boost::uint32_t)0x80);
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_integer_limits: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_unchecked_write()
+  {
+    try
+    {
+      unsigned char buf[ENOUGH_SIZE];
+      unsigned char exact_buf[ENOUGH_SIZE];
+
+      usr::person src;
+      src.name = "lordoffox";
+      src.age = 33;
+      src.married = true;
+
+      // enough room, members written without bound checks
+      amsg::zero_copy_buffer writer;
+      writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(writer, src);
+      BOOST_ASSERT(!writer.bad());
+      BOOST_ASSERT(writer.write_length() == amsg::size_of(src));
+
+      // no room for unchecked write, checked write gives same bytes
+      amsg::zero_copy_buffer exact_writer;
+      exact_writer.set_write(exact_buf, amsg::size_of(src));
+      amsg::write(exact_writer, src);
+      BOOST_ASSERT(!exact_writer.bad());
+      BOOST_ASSERT(exact_writer.write_length() == writer.write_length());
+      BOOST_ASSERT(std::memcmp(buf, exact_buf, writer.write_length()) == 0);
+
+      // error still reported by checked write
+      src.name.assign(31, 'x');
+      writer.clear();
+      writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(writer, src);
+      BOOST_ASSERT(writer.error());
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_unchecked_write: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_error_path()
+  {
+    try
+    {
+      unsigned char buf[ENOUGH_SIZE];
+
+      std::vector<usr::person> src(3);
+      src[2].name.assign(31, 'x');
+
+      amsg::zero_copy_buffer writer;
+      writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(writer, src);
+      BOOST_ASSERT(writer.error());
+#ifndef AMSG_NO_ERROR_PATH
+      BOOST_ASSERT(writer.error_path().size() == 2);
+      BOOST_ASSERT(writer.info() == ".name&smax(30)[2]");
+#endif
+
+      writer.clear();
+      BOOST_ASSERT(!writer.error());
+      BOOST_ASSERT(writer.info().empty());
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_error_path: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_map_decode()
+  {
+    try
+    {
+      unsigned char buf[ENOUGH_SIZE];
+
+      std::map<std::string, usr::person> src;
+      std::unordered_map<boost::int32_t, std::string> src2;
+      for (int i = 0; i < 20; ++i)
+      {
+        usr::person p;
+        p.name = "person";
+        p.name.append(1, (char)('a' + i));
+        p.age = i;
+        p.married = i % 2 == 0;
+        src[p.name] = p;
+        src2[i * 31] = p.name;
+      }
+
+      amsg::zero_copy_buffer writer;
+      writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(writer, src);
+      amsg::write(writer, src2);
+      BOOST_ASSERT(!writer.bad());
+
+      std::map<std::string, usr::person> des;
+      std::unordered_map<boost::int32_t, std::string> des2;
+      amsg::zero_copy_buffer reader;
+      reader.set_read(buf, writer.write_length());
+      amsg::read(reader, des);
+      amsg::read(reader, des2);
+      BOOST_ASSERT(!reader.bad());
+      BOOST_ASSERT(src == des);
+      BOOST_ASSERT(src2 == des2);
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_map_decode: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_length_check()
+  {
+    try
+    {
+      unsigned char buf[ENOUGH_SIZE];
+
+      // corrupted length, far more elements than bytes left
+      amsg::zero_copy_buffer writer;
+      writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(writer, (boost::uint32_t)0xffffffff);
+      amsg::write(writer, (boost::uint32_t)1);
+      BOOST_ASSERT(!writer.bad());
+
+      std::vector<usr::person> persons;
+      amsg::zero_copy_buffer reader;
+      reader.set_read(buf, writer.write_length());
+      amsg::read(reader, persons);
+      BOOST_ASSERT(reader.error_code() == amsg::stream_buffer_overflow);
+      BOOST_ASSERT(persons.capacity() == 0);
+
+      std::string str;
+      reader.clear();
+      amsg::read(reader, str);
+      BOOST_ASSERT(reader.error_code() == amsg::stream_buffer_overflow);
+      BOOST_ASSERT(str.empty());
+
+      std::map<boost::int32_t, double> numbers;
+      reader.clear();
+      amsg::read(reader, numbers);
+      BOOST_ASSERT(reader.error_code() == amsg::stream_buffer_overflow);
+
+      // elements decoded into existing ones, missing ones added
+      std::vector<usr::person> src(3), des(2);
+      src[0].name = "lordoffox";
+      src[2].age = 33;
+      writer.clear();
+      writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(writer, src);
+      reader.clear();
+      reader.set_read(buf, writer.write_length());
+      amsg::read(reader, des);
+      BOOST_ASSERT(!reader.error());
+      BOOST_ASSERT(src == des);
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_length_check: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_decode_limits()
+  {
+    try
+    {
+      unsigned char buf[ENOUGH_SIZE];
+
+      std::vector<usr::person> src(10);
+      for (std::size_t i = 0; i < src.size(); ++i)
+      {
+        src[i].name = "lordoffox";
+        src[i].age = 33;
+      }
+      std::vector<std::vector<usr::person> > nested(2, src);
+
+      amsg::zero_copy_buffer writer;
+      writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(writer, src);
+      BOOST_ASSERT(!writer.bad());
+
+      // unlimited by default
+      std::vector<usr::person> des;
+      amsg::zero_copy_buffer reader;
+      reader.set_read(buf, writer.write_length());
+      amsg::read(reader, des);
+      BOOST_ASSERT(!reader.error());
+      BOOST_ASSERT(reader.decoded_elements() == 10);
+      BOOST_ASSERT(src == des);
+
+      // elements
+      reader.set_read(buf, writer.write_length());
+      reader.set_decode_limits(amsg::decode_limits(0, 5));
+      amsg::read(reader, des);
+      BOOST_ASSERT(reader.error_code() == amsg::decode_limit_exceeded);
+
+      // bytes, every name takes 9
+      reader.clear();
+      reader.set_read(buf, writer.write_length());
+      reader.set_decode_limits(amsg::decode_limits(10 * sizeof(usr::person) + 40));
+      amsg::read(reader, des);
+      BOOST_ASSERT(reader.error_code() == amsg::decode_limit_exceeded);
+
+      // depth
+      writer.clear();
+      writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(writer, nested);
+      std::vector<std::vector<usr::person> > nested_des;
+      reader.clear();
+      reader.set_read(buf, writer.write_length());
+      reader.set_decode_limits(amsg::decode_limits(0, 0, 1));
+      amsg::read(reader, nested_des);
+      BOOST_ASSERT(!reader.error());
+      BOOST_ASSERT(nested == nested_des);
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_decode_limits: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_read_fields()
+  {
+    try
+    {
+      unsigned char buf[ENOUGH_SIZE];
+
+      std::vector<usr::person> src(2);
+      src[0].name = "lordoffox";
+      src[0].age = 33;
+      src[0].married = true;
+      src[1] = src[0];
+
+      amsg::zero_copy_buffer writer;
+      writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(writer, src[0]);
+      amsg::write(writer, src[1]);
+      BOOST_ASSERT(!writer.bad());
+
+      // compile time, age only
+      usr::person des;
+      des.age = 0;
+      des.married = false;
+      amsg::zero_copy_buffer reader;
+      reader.set_read(buf, writer.write_length());
+      amsg::read_fields<amsg::field_set<1> >(reader, des);
+      BOOST_ASSERT(!reader.error());
+      BOOST_ASSERT(des.name.empty());
+      BOOST_ASSERT(des.age == 33);
+      BOOST_ASSERT(des.married == false);
+
+      // run time, next struct starts where expected
+      usr::person des2;
+      des2.age = 0;
+      des2.married = false;
+      amsg::read_fields(reader, des2, amsg::field_of(des2, des2.name) | amsg::field_of(des2, des2.married));
+      BOOST_ASSERT(!reader.error());
+      BOOST_ASSERT(reader.read_length() == writer.write_length());
+      BOOST_ASSERT(des2.name == "lordoffox");
+      BOOST_ASSERT(des2.age == 0);
+      BOOST_ASSERT(des2.married == true);
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_read_fields: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_lazy_view()
+  {
+    try
+    {
+      unsigned char buf[ENOUGH_SIZE];
+
+      usr::team src;
+      src.name = "amsg";
+      src.leader.name = "lordoffox";
+      src.leader.age = 33;
+      src.leader.married = true;
+      src.members.resize(3, src.leader);
+      src.members[2].name = "nobody";
+      src.members[2].age = 0;
+
+      amsg::zero_copy_buffer writer;
+      writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(writer, src);
+      amsg::write(writer, src.leader);
+      BOOST_ASSERT(!writer.bad());
+
+      amsg::zero_copy_buffer reader;
+      reader.set_read(buf, writer.write_length());
+      amsg::view<usr::team> team = amsg::make_view<usr::team>(reader);
+      BOOST_ASSERT(!reader.error());
+      BOOST_ASSERT(reader.read_length() == amsg::size_of(src));
+      BOOST_ASSERT(team.length() == amsg::size_of(src));
+      BOOST_ASSERT(team.get(&usr::team::name) == "amsg");
+
+      amsg::view<usr::person> leader = team.sub_view(&usr::team::leader);
+      BOOST_ASSERT(leader.get(&usr::person::age) == 33);
+      BOOST_ASSERT(leader.get(&usr::person::name) == "lordoffox");
+
+      amsg::sequence_view<usr::person> members = team.sequence(&usr::team::members);
+      BOOST_ASSERT(members.size() == 3);
+      BOOST_ASSERT(members[2].get(&usr::person::name) == "nobody");
+      BOOST_ASSERT(members[2].get(&usr::person::age) == 0);
+      BOOST_ASSERT(members[2].get(&usr::person::married) == true);
+      BOOST_ASSERT(members[0].get(&usr::person::age) == 33);
+      BOOST_ASSERT(members[3].empty());
+      BOOST_ASSERT(!members.error());
+
+      // next struct in stream
+      amsg::view<usr::person> next = amsg::make_view<usr::person>(reader);
+      BOOST_ASSERT(next.get(&usr::person::married) == true);
+      BOOST_ASSERT(reader.read_length() == writer.write_length());
+
+      // truncated
+      amsg::view<usr::team> broken(buf, 5);
+      BOOST_ASSERT(broken.error_code() == amsg::stream_buffer_overflow);
+      BOOST_ASSERT(broken.get(&usr::team::name).empty());
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_lazy_view: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_indexed_sequence()
+  {
+    try
+    {
+      unsigned char buf[ENOUGH_SIZE];
+
+      usr::roster src;
+      src.version = 7;
+      src.records.resize(10);
+      for (std::size_t i = 0; i < src.records.size(); ++i)
+      {
+        src.records[i].name = std::string(i + 1, 'a');
+        src.records[i].age = (boost::int32_t)i;
+        src.records[i].married = i % 2 == 0;
+      }
+
+      amsg::zero_copy_buffer writer;
+      writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(writer, src);
+      BOOST_ASSERT(!writer.bad());
+      BOOST_ASSERT(writer.write_length() == amsg::size_of(src));
+
+      // full decode
+      usr::roster des;
+      amsg::zero_copy_buffer reader;
+      reader.set_read(buf, writer.write_length());
+      amsg::read(reader, des);
+      BOOST_ASSERT(!reader.error());
+      BOOST_ASSERT(des.records == src.records);
+      BOOST_ASSERT(des.version == 7);
+
+      // indexed sequence skipped at once
+      usr::roster des2;
+      des2.version = 0;
+      reader.set_read(buf, writer.write_length());
+      amsg::read_fields<amsg::field_set<1> >(reader, des2);
+      BOOST_ASSERT(!reader.error());
+      BOOST_ASSERT(des2.records.empty());
+      BOOST_ASSERT(des2.version == 7);
+
+      // seek by offset table
+      reader.set_read(buf, writer.write_length());
+      amsg::view<usr::roster> v = amsg::make_view<usr::roster>(reader);
+      amsg::sequence_view<usr::person> records = v.sequence(&usr::roster::records);
+      BOOST_ASSERT(records.indexed());
+      BOOST_ASSERT(records.size() == 10);
+      for (std::size_t i = 10; i > 0; --i)
+      {
+        BOOST_ASSERT(records[i - 1].get(&usr::person::name) == src.records[i - 1].name);
+      }
+      BOOST_ASSERT(records[10].empty());
+      BOOST_ASSERT(v.get(&usr::roster::version) == 7);
+      BOOST_ASSERT(v.get(&usr::roster::records) == src.records);
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_indexed_sequence: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_parallel_write()
+  {
+    try
+    {
+      std::vector<usr::person> src(3000);
+      for (std::size_t i = 0; i < src.size(); ++i)
+      {
+        src[i].name = std::string(i % 30, 'a');
+        src[i].age = (boost::int32_t)(i * 1000);
+        src[i].married = i % 3 == 0;
+      }
+      std::size_t size = amsg::size_of(src);
+      std::vector<unsigned char> serial(size);
+      std::vector<unsigned char> parallel(size);
+
+      amsg::zero_copy_buffer writer;
+      writer.set_write(&serial[0], size);
+      amsg::write(writer, src);
+      BOOST_ASSERT(!writer.error());
+
+      amsg::thread_executor executor(4);
+      amsg::zero_copy_buffer pwriter;
+      pwriter.set_write(&parallel[0], size);
+      amsg::parallel_write(pwriter, src, executor);
+      BOOST_ASSERT(!pwriter.error());
+      BOOST_ASSERT(pwriter.write_length() == size);
+      BOOST_ASSERT(serial == parallel);
+
+      // not enough room, nothing is advanced
+      amsg::zero_copy_buffer small;
+      small.set_write(&parallel[0], size - 1);
+      amsg::parallel_write(small, src, executor);
+      BOOST_ASSERT(small.error_code() == amsg::stream_buffer_overflow);
+      BOOST_ASSERT(small.write_length() == 0);
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_parallel_write: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_parallel_read()
+  {
+    try
+    {
+      std::vector<usr::person> src(3000);
+      for (std::size_t i = 0; i < src.size(); ++i)
+      {
+        src[i].name = std::string(i % 30, 'a');
+        src[i].age = (boost::int32_t)(i * 1000);
+        src[i].married = i % 3 == 0;
+      }
+      std::size_t size = amsg::size_of(src);
+      std::vector<unsigned char> buf(size);
+      amsg::zero_copy_buffer writer;
+      writer.set_write(&buf[0], size);
+      amsg::write(writer, src);
+      BOOST_ASSERT(!writer.error());
+
+      amsg::thread_executor executor(4);
+      std::vector<usr::person> des;
+      amsg::zero_copy_buffer reader;
+      reader.set_read(&buf[0], size);
+      amsg::parallel_read(reader, des, executor);
+      BOOST_ASSERT(!reader.error());
+      BOOST_ASSERT(reader.read_length() == size);
+      BOOST_ASSERT(des == src);
+
+      // name over smax(30) in element 2000, same error and path as serial read
+      std::size_t offset = amsg::size_of((boost::uint32_t)src.size());
+      for (std::size_t i = 0; i < 2000; ++i)
+      {
+        offset += amsg::size_of(src[i]);
+      }
+      // length prefix, tag, name length
+      BOOST_ASSERT(buf[offset + 2] == 20);
+      buf[offset + 2] = 31;
+
+      std::vector<usr::person> serial;
+      amsg::zero_copy_buffer sreader;
+      sreader.set_read(&buf[0], size);
+      amsg::read(sreader, serial);
+      reader.set_read(&buf[0], size);
+      amsg::parallel_read(reader, des, executor);
+      BOOST_ASSERT(reader.error_code() == sreader.error_code());
+      BOOST_ASSERT(reader.error_code() != amsg::success);
+      BOOST_ASSERT(reader.info() == sreader.info());
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_parallel_read: " << ex.what() << std::endl;
+    }
+  }
+
+  /// refill source handing out at most step bytes of data at a time.
+  struct chunk_source
+  {
+    const std::vector<unsigned char>* data;
+    std::size_t pos;
+    std::size_t step;
+
+    std::size_t operator()(unsigned char* buffer, std::size_t len)
+    {
+      std::size_t n = data->size() - pos;
+      n = n < len ? n : len;
+      n = n < step ? n : step;
+      std::memcpy(buffer, &(*data)[pos], n);
+      pos += n;
+      return n;
+    }
+  };
+
+  static void test_input_buffer()
+  {
+    try
+    {
+      std::vector<usr::person> src(100);
+      for (std::size_t i = 0; i < src.size(); ++i)
+      {
+        src[i].name = std::string(i % 30, 'a' + (char)(i % 26));
+        src[i].age = (boost::int32_t)(i * 1000);
+        src[i].married = i % 3 == 0;
+      }
+      std::size_t size = amsg::size_of(src);
+      std::vector<unsigned char> buf(size);
+      amsg::zero_copy_buffer writer;
+      writer.set_write(&buf[0], size);
+      amsg::write(writer, src);
+      BOOST_ASSERT(!writer.error());
+
+      // whole message is far larger than window
+      chunk_source source = { &buf, 0, 7 };
+      amsg::input_buffer reader(source, 64);
+      std::vector<usr::person> des;
+      amsg::read(reader, des);
+      BOOST_ASSERT(!reader.error());
+      BOOST_ASSERT(reader.read_length() == size);
+      BOOST_ASSERT(des == src);
+
+      // bytes views point into window, one struct at a time
+      chunk_source view_source = { &buf, 0, 5 };
+      amsg::input_buffer view_reader(view_source, 64);
+      boost::uint32_t len = 0;
+      amsg::read(view_reader, len);
+      for (std::size_t i = 0; i < len; ++i)
+      {
+        usr::person_view pv;
+        amsg::read(view_reader, pv);
+        BOOST_ASSERT(!view_reader.error());
+        BOOST_ASSERT(pv.name == amsg::bytes_view(src[i].name));
+      }
+
+      // truncated source
+      std::vector<unsigned char> part(buf.begin(), buf.begin() + size / 2);
+      chunk_source part_source = { &part, 0, 64 };
+      amsg::input_buffer part_reader(part_source, 64);
+      amsg::read(part_reader, des);
+      BOOST_ASSERT(part_reader.error_code() == amsg::stream_buffer_overflow);
+
+      // string length too wide for uint32, error is kept and no length is used
+      std::vector<unsigned char> wide(9, 0xff);
+      wide[0] = 0x87;
+      chunk_source wide_source = { &wide, 0, 64 };
+      amsg::input_buffer wide_reader(wide_source, 64);
+      std::string str;
+      amsg::read(wide_reader, str);
+      BOOST_ASSERT(wide_reader.error_code() == amsg::value_too_large_to_integer_number);
+      BOOST_ASSERT(str.empty());
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_input_buffer: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_push_parser()
+  {
+    try
+    {
+      unsigned char buf[ENOUGH_SIZE];
+
+      usr::team src;
+      src.name = "amsg";
+      src.leader.name = "lordoffox";
+      src.leader.age = 33;
+      src.leader.married = true;
+      src.members.resize(3, src.leader);
+      src.members[1].name = "nobody";
+
+      amsg::zero_copy_buffer writer;
+      writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(writer, src);
+      amsg::write(writer, src);
+      BOOST_ASSERT(!writer.bad());
+      std::size_t size = writer.write_length();
+
+      // 3 bytes at a time, two messages back to back
+      amsg::push_parser<usr::team> parser;
+      std::size_t count = 0;
+      for (std::size_t pos = 0; pos < size; pos += 3)
+      {
+        std::size_t len = size - pos < 3 ? size - pos : 3;
+        std::size_t used = 0;
+        while (used < len)
+        {
+          used += parser.feed(buf + pos + used, len - used);
+          BOOST_ASSERT(!parser.failed());
+          if (parser.done())
+          {
+            usr::team& des = parser.value();
+            BOOST_ASSERT(des.name == src.name);
+            BOOST_ASSERT(des.leader == src.leader);
+            BOOST_ASSERT(des.members == src.members);
+            des = usr::team();
+            parser.reset();
+            ++count;
+          }
+        }
+      }
+      BOOST_ASSERT(count == 2);
+      BOOST_ASSERT(parser.need_more());
+
+      // name over smax(30) in members[1]: length prefix, tag, name length
+      std::size_t offset = writer.write_length() / 2 - amsg::size_of(src.members[2]) - amsg::size_of(src.members[1]);
+      BOOST_ASSERT(buf[offset + 2] == 6);
+      buf[offset + 2] = 31;
+      parser.reset();
+      parser.feed(buf, size);
+      BOOST_ASSERT(parser.failed());
+      BOOST_ASSERT(parser.error_code() == amsg::sequence_length_overflow);
+      BOOST_ASSERT(parser.info() == ".name&smax(30)[1].members");
+
+      // same as read
+      usr::team des;
+      amsg::zero_copy_buffer reader;
+      reader.set_read(buf, size);
+      amsg::read(reader, des);
+      BOOST_ASSERT(reader.error_code() == parser.error_code());
+      BOOST_ASSERT(reader.info() == parser.info());
+
+      // failed inside a member decoded whole (sidx vector), path goes on inside it
+      usr::roster roster;
+      roster.version = 1;
+      roster.records.assign(3, src.leader);
+      roster.records[1].name = "zzzzzz";
+      amsg::zero_copy_buffer roster_writer;
+      roster_writer.set_write(buf, ENOUGH_SIZE);
+      amsg::write(roster_writer, roster);
+      BOOST_ASSERT(!roster_writer.bad());
+      std::size_t roster_size = roster_writer.write_length();
+      unsigned char const name_bytes[] = "\x06zzzzzz";
+      unsigned char * name_pos = std::search(buf, buf + roster_size, name_bytes, name_bytes + 7);
+      BOOST_ASSERT(name_pos != buf + roster_size);
+      *name_pos = 31;
+      amsg::push_parser<usr::roster> roster_parser;
+      roster_parser.feed(buf, roster_size);
+      BOOST_ASSERT(roster_parser.failed());
+      BOOST_ASSERT(roster_parser.info() == ".name&smax(30)[1].records&sidx(4)");
+      usr::roster roster_des;
+      amsg::zero_copy_buffer roster_reader;
+      roster_reader.set_read(buf, roster_size);
+      amsg::read(roster_reader, roster_des);
+      BOOST_ASSERT(roster_reader.error_code() == roster_parser.error_code());
+      BOOST_ASSERT(roster_reader.info() == roster_parser.info());
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_push_parser: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_record_ring()
+  {
+    try
+    {
+      std::vector<usr::person> src(200);
+      for (std::size_t i = 0; i < src.size(); ++i)
+      {
+        src[i].name.assign(i % 30, 'a' + i % 26);
+        src[i].age = (boost::int32_t)i;
+        src[i].married = i % 3 == 0;
+      }
+
+      // records put in while there is room, taken out 4 at most a batch, wrapping ring end
+      amsg::record_ring ring(64);
+      BOOST_ASSERT(ring.capacity() == 64);
+      amsg::bytes_view records[4];
+      std::size_t put = 0;
+      std::size_t got = 0;
+      while (got < src.size())
+      {
+        while (put < src.size() && ring.write_record(src[put]))
+        {
+          ++put;
+        }
+        std::size_t count = ring.read_records(records, 4);
+        BOOST_ASSERT(count > 0);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+          usr::person des;
+          amsg::zero_copy_buffer reader;
+          reader.set_read(records[i].data(), records[i].size());
+          amsg::read(reader, des);
+          BOOST_ASSERT(!reader.error());
+          BOOST_ASSERT(reader.read_remain() == 0);
+          BOOST_ASSERT(des == src[got]);
+          ++got;
+        }
+        ring.release();
+      }
+      BOOST_ASSERT(ring.size() == 0);
+      BOOST_ASSERT(!ring.error());
+
+      // received 7 bytes at a time, length prefixes and records split anywhere
+      std::vector<unsigned char> buf(ENOUGH_SIZE);
+      amsg::zero_copy_buffer writer;
+      writer.set_write(&buf[0], buf.size());
+      for (std::size_t i = 0; i < 20; ++i)
+      {
+        amsg::write(writer, src[i]);
+      }
+      BOOST_ASSERT(!writer.bad());
+      std::size_t size = writer.write_length();
+      got = 0;
+      for (std::size_t pos = 0; pos < size;)
+      {
+        std::size_t room = 0;
+        unsigned char * dest = ring.write_ptr(room);
+        std::size_t len = size - pos < 7 ? size - pos : 7;
+        len = len < room ? len : room;
+        std::memcpy(dest, &buf[pos], len);
+        ring.commit(len);
+        pos += len;
+        std::size_t count = ring.read_records(records, 4);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+          usr::person des;
+          amsg::zero_copy_buffer reader;
+          reader.set_read(records[i].data(), records[i].size());
+          amsg::read(reader, des);
+          BOOST_ASSERT(des == src[got]);
+          ++got;
+        }
+        ring.release();
+      }
+      BOOST_ASSERT(got == 20);
+
+      // record larger than ring
+      usr::person big;
+      big.name.assign(30, 'b');
+      big.age = 1;
+      big.married = false;
+      amsg::record_ring small(16);
+      BOOST_ASSERT(!small.write_record(big));
+      writer.set_write(&buf[0], buf.size());
+      amsg::write(writer, big);
+      BOOST_ASSERT(small.append(&buf[0], 16));
+      BOOST_ASSERT(small.read_records(records, 4) == 0);
+      BOOST_ASSERT(small.error_code() == amsg::stream_buffer_overflow);
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_record_ring: " << ex.what() << std::endl;
+    }
+  }
+
+  static void test_record_log()
+  {
+#ifndef _WIN32
+    try
+    {
+      const char * path = "amsg_test_record.log";
+      std::vector<usr::person> src(1000);
+      std::size_t records_size = amsg::record_log_header_size;
+      amsg::record_log_writer writer(256);
+      BOOST_ASSERT(writer.open(path, 64));
+      for (std::size_t i = 0; i < src.size(); ++i)
+      {
+        src[i].name.assign(i % 30, 'a' + i % 26);
+        src[i].age = (boost::int32_t)i;
+        src[i].married = i % 3 == 0;
+        BOOST_ASSERT(writer.append(src[i]));
+        records_size += amsg::size_of(src[i]);
+      }
+      BOOST_ASSERT(writer.close());
+
+      amsg::record_log log;
+      BOOST_ASSERT(log.open(path));
+      BOOST_ASSERT(log.indexed());
+      BOOST_ASSERT(log.count() == src.size());
+      amsg::zero_copy_buffer reader;
+      for (std::size_t i = 0; i < src.size(); ++i)
+      {
+        usr::person des;
+        BOOST_ASSERT(log.next(reader));
+        amsg::read(reader, des);
+        BOOST_ASSERT(!reader.error());
+        BOOST_ASSERT(reader.read_remain() == 0);
+        BOOST_ASSERT(des == src[i]);
+      }
+      BOOST_ASSERT(!log.next(reader));
+
+      usr::person des;
+      BOOST_ASSERT(log.seek(500));
+      BOOST_ASSERT(log.next(reader));
+      amsg::read(reader, des);
+      BOOST_ASSERT(des == src[500]);
+      BOOST_ASSERT(log.position() == 501);
+      BOOST_ASSERT(log.seek(src.size()));
+      BOOST_ASSERT(!log.next(reader));
+      BOOST_ASSERT(!log.seek(src.size() + 1));
+      log.close();
+
+      // writer did not close: no index and a torn last record
+      BOOST_ASSERT(::truncate(path, (off_t)records_size - 3) == 0);
+      BOOST_ASSERT(log.open(path));
+      BOOST_ASSERT(!log.indexed());
+      BOOST_ASSERT(log.count() == src.size() - 1);
+      BOOST_ASSERT(log.seek(998));
+      BOOST_ASSERT(log.next(reader));
+      amsg::read(reader, des);
+      BOOST_ASSERT(des == src[998]);
+      BOOST_ASSERT(!log.next(reader));
+      log.close();
+
+      // closed with no records: empty index
+      BOOST_ASSERT(writer.open(path, 64));
+      BOOST_ASSERT(writer.close());
+      BOOST_ASSERT(log.open(path));
+      BOOST_ASSERT(log.indexed());
+      BOOST_ASSERT(log.count() == 0);
+      BOOST_ASSERT(!log.next(reader));
+      log.close();
+      ::unlink(path);
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_record_log: " << ex.what() << std::endl;
+    }
+#endif
+  }
+
+  static void test_group_writer()
+  {
+#ifndef _WIN32
+    try
+    {
+      const char * path = "amsg_test_group.log";
+      int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      BOOST_ASSERT(fd >= 0);
+      const int threads = 4;
+      const int count = 5000;
+      std::size_t size = 0;
+      {
+        // small blocks and few of them, producers wait for writes
+        amsg::group_writer writer(fd, true, 200, 256, 4);
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t)
+        {
+          workers.emplace_back([&writer, t, count]()
+          {
+            amsg::group_writer::producer producer(writer);
+            for (int i = 0; i < count; ++i)
+            {
+              usr::person src;
+              src.name.assign(i % 30, 'a' + t);
+              src.age = t * count + i;
+              src.married = i % 2 == 0;
+              BOOST_ASSERT(producer.append(src));
+            }
+          });
+        }
+        for (int t = 0; t < threads; ++t)
+        {
+          workers[t].join();
+        }
+        BOOST_ASSERT(writer.flush());
+        struct stat st;
+        BOOST_ASSERT(::fstat(fd, &st) == 0);
+        size = (std::size_t)st.st_size;
+      }
+      ::close(fd);
+
+      // records of each producer in order, whole
+      std::vector<unsigned char> buf(size);
+      fd = ::open(path, O_RDONLY);
+      BOOST_ASSERT(::read(fd, &buf[0], size) == (ssize_t)size);
+      ::close(fd);
+      std::vector<int> next(threads, 0);
+      amsg::zero_copy_buffer reader;
+      reader.set_read(&buf[0], size);
+      for (int n = 0; n < threads * count; ++n)
+      {
+        usr::person des;
+        amsg::read(reader, des);
+        BOOST_ASSERT(!reader.error());
+        int t = des.age / count;
+        BOOST_ASSERT(t >= 0 && t < threads);
+        BOOST_ASSERT(des.age == t * count + next[t]);
+        BOOST_ASSERT(des.name == std::string(next[t] % 30, 'a' + t));
+        BOOST_ASSERT(des.married == (next[t] % 2 == 0));
+        ++next[t];
+      }
+      BOOST_ASSERT(reader.read_remain() == 0);
+
+      // write fails (read only descriptor): appends fail after it, even with room in block
+      fd = ::open(path, O_RDONLY);
+      BOOST_ASSERT(fd >= 0);
+      {
+        amsg::group_writer writer(fd);
+        amsg::group_writer::producer producer(writer);
+        usr::person src;
+        src.name = "lost";
+        src.age = 1;
+        src.married = false;
+        BOOST_ASSERT(producer.append(src));
+        BOOST_ASSERT(!writer.flush());
+        BOOST_ASSERT(writer.error() == EBADF);
+        BOOST_ASSERT(!producer.append(src));
+      }
+      ::close(fd);
+      ::unlink(path);
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_group_writer: " << ex.what() << std::endl;
+    }
+#endif
+  }
+
+  static void test_arena()
+  {
+    try
+    {
+      std::vector<unsigned char> buf(ENOUGH_SIZE * 4);
+      amsg::zero_copy_buffer writer;
+      writer.set_write(&buf[0], buf.size());
+
+      // built outside any scope: heap
+      usr::ledger src;
+      BOOST_ASSERT(src.name.get_allocator().get_arena() == 0);
+      src.name = "ledger of the day, longer than small string";
+      for (int i = 0; i < 50; ++i)
+      {
+        src.tags.push_back(amsg::arena_string(20 + i % 10, (char)('a' + i % 26)));
+      }
+      for (int i = 0; i < 20; ++i)
+      {
+        src.notes[i * 7] = amsg::arena_string(30, (char)('A' + i));
+      }
+      amsg::write(writer, src);
+      BOOST_ASSERT(!writer.bad());
+      std::size_t size = writer.write_length();
+
+      // every string, vector and map node of a decode in one arena, blocks reused after reset
+      amsg::arena arena(4096);
+      std::size_t capacity = 0;
+      usr::ledger out;
+      for (int round = 0; round < 3; ++round)
+      {
+        {
+          amsg::arena_scope scope(arena);
+          usr::ledger des;
+          amsg::zero_copy_buffer reader;
+          reader.set_read(&buf[0], size);
+          amsg::read(reader, des);
+          BOOST_ASSERT(!reader.error());
+          BOOST_ASSERT(des.name == src.name);
+          BOOST_ASSERT(des.tags == src.tags);
+          BOOST_ASSERT(des.notes == src.notes);
+          BOOST_ASSERT(des.name.get_allocator().get_arena() == &arena);
+          BOOST_ASSERT(des.tags[10].get_allocator().get_arena() == &arena);
+          BOOST_ASSERT(des.notes.get_allocator().get_arena() == &arena);
+          BOOST_ASSERT(des.notes.begin()->second.get_allocator().get_arena() == &arena);
+          BOOST_ASSERT(arena.used() > size);
+
+          // copied out of arena: copy is on heap, assignment keeps target's heap allocator
+          usr::ledger copy(des);
+          BOOST_ASSERT(copy.name.get_allocator().get_arena() == 0);
+          BOOST_ASSERT(copy.tags.get_allocator().get_arena() == 0);
+          BOOST_ASSERT(copy.tags[10].get_allocator().get_arena() == 0);
+          BOOST_ASSERT(copy.notes.get_allocator().get_arena() == 0);
+          out = des;
+        }
+        BOOST_ASSERT(out.name.get_allocator().get_arena() == 0);
+        BOOST_ASSERT(out.tags.get_allocator().get_arena() == 0);
+        BOOST_ASSERT(out.tags[10].get_allocator().get_arena() == 0);
+        BOOST_ASSERT(out.notes.get_allocator().get_arena() == 0);
+        BOOST_ASSERT(out.notes.begin()->second.get_allocator().get_arena() == 0);
+        if (round == 0)
+        {
+          capacity = arena.capacity();
+        }
+        BOOST_ASSERT(arena.capacity() == capacity);
+        arena.reset();
+        BOOST_ASSERT(arena.used() == 0);
+      }
+      BOOST_ASSERT(amsg::current_arena() == 0);
+      BOOST_ASSERT(out.name == src.name);
+      BOOST_ASSERT(out.tags == src.tags);
+      BOOST_ASSERT(out.notes == src.notes);
+
+#ifdef AMSG_HAS_MEMORY_RESOURCE
+      // std::pmr containers built on arena, map temporaries too
+      std::vector<std::string> src_tags(src.tags.size());
+      std::map<std::string, std::string> src_notes;
+      for (std::size_t i = 0; i < src.tags.size(); ++i)
+      {
+        src_tags[i].assign(src.tags[i].data(), src.tags[i].size());
+        src_notes[src_tags[i]] = src_tags[i] + src_tags[i];
+      }
+      writer.set_write(&buf[0], buf.size());
+      amsg::write(writer, src_tags);
+      amsg::write(writer, src_notes);
+      BOOST_ASSERT(!writer.bad());
+      std::pmr::vector<std::pmr::string> tags(&arena);
+      std::pmr::map<std::pmr::string, std::pmr::string> notes(&arena);
+      amsg::zero_copy_buffer reader;
+      reader.set_read(&buf[0], writer.write_length());
+      amsg::read(reader, tags);
+      amsg::read(reader, notes);
+      BOOST_ASSERT(!reader.error());
+      BOOST_ASSERT(tags.size() == src_tags.size() && notes.size() == src_notes.size());
+      for (std::size_t i = 0; i < tags.size(); ++i)
+      {
+        BOOST_ASSERT(std::string(tags[i].data(), tags[i].size()) == src_tags[i]);
+        BOOST_ASSERT(tags[i].get_allocator().resource() == &arena);
+        BOOST_ASSERT(notes[tags[i]].size() == src_tags[i].size() * 2);
+      }
+      BOOST_ASSERT(notes.begin()->first.get_allocator().resource() == &arena);
+#endif
+    }
+    catch (std::exception& ex)
+    {
+      std::cerr << "test_arena: " << ex.what() << std::endl;
+    }
+  }
 };
 }
@@ -11,13 +11,25 @@
 #define AMSG_ZEROCOPY_HPP
 
 #include "amsg.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/uio.h>  /* iovec */
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# define AMSG_SSE2
+# include <emmintrin.h>
+#endif
 
 namespace amsg
 {
   struct zero_copy_buffer : public basic_store
   {
   private:
-    ::std::string		m_error_info;
+    mutable ::std::string		m_error_info;
 
     unsigned char const* m_read_header_ptr;
     unsigned char* m_write_header_ptr;
@@ -26,6 +38,206 @@ namespace amsg
     unsigned char const* m_read_tail_ptr;
     unsigned char const* m_write_tail_ptr;
     int							m_status;
+    bool						m_single_pass;
+    bool						m_growable;
+    bool						m_write_owned;
+    bool						m_read_padded;
+
+    /// large bytes referenced instead of copied, offset is where they are in write region.
+    struct borrowed_segment
+    {
+      ::std::size_t offset;
+      unsigned char const* data;
+      ::std::size_t length;
+    };
+    ::std::vector<borrowed_segment> m_borrowed;
+    ::std::size_t m_gather_threshold;
+
+    /// single pass struct whose length prefix is reserved, not patched yet.
+    /// gap_length is m_gap_length when it was reserved.
+    struct open_prefix
+    {
+      ::std::size_t offset;
+      ::std::size_t length;
+      ::std::size_t gap_length;
+    };
+    ::std::vector<open_prefix> m_open_prefixes;
+
+    /// reserved prefix bytes a patched prefix left unused. they are squeezed out in one pass
+    /// when outermost struct is done (or write region is short of room), so bytes of nested
+    /// structs are moved once, not once per level.
+    struct prefix_gap
+    {
+      ::std::size_t offset;
+      ::std::size_t length;
+    };
+    ::std::vector<prefix_gap> m_gaps;
+    ::std::size_t m_gap_length;
+
+    friend ::std::size_t begin_length_prefix(zero_copy_buffer& stream);
+    friend void end_length_prefix(zero_copy_buffer& stream, ::std::size_t index);
+
+    /// all state of other, write region it owns is copied to a heap region of this one.
+    void copy_from(const zero_copy_buffer& other)
+    {
+      this->m_error_info = other.m_error_info;
+      this->m_read_header_ptr = other.m_read_header_ptr;
+      this->m_write_header_ptr = other.m_write_header_ptr;
+      this->m_read_ptr = other.m_read_ptr;
+      this->m_write_ptr = other.m_write_ptr;
+      this->m_read_tail_ptr = other.m_read_tail_ptr;
+      this->m_write_tail_ptr = other.m_write_tail_ptr;
+      this->m_status = other.m_status;
+      this->m_single_pass = other.m_single_pass;
+      this->m_growable = other.m_growable;
+      this->m_write_owned = false;
+      this->m_read_padded = other.m_read_padded;
+      this->m_borrowed = other.m_borrowed;
+      this->m_gather_threshold = other.m_gather_threshold;
+      this->m_open_prefixes = other.m_open_prefixes;
+      this->m_gaps = other.m_gaps;
+      this->m_gap_length = other.m_gap_length;
+      if (other.m_write_owned)
+      {
+        ::std::size_t length = other.m_write_ptr - other.m_write_header_ptr;
+        ::std::size_t capacity = other.m_write_tail_ptr - other.m_write_header_ptr;
+        unsigned char * buffer = (unsigned char *)::std::malloc(capacity);
+        if (!buffer)
+        {
+          set_write((unsigned char*)0, 0);
+          this->m_status = write_overflow;
+          return;
+        }
+        ::std::memcpy(buffer, other.m_write_header_ptr, length);
+        this->m_write_owned = true;
+        this->m_write_header_ptr = buffer;
+        this->m_write_ptr = buffer + length;
+        this->m_write_tail_ptr = buffer + capacity;
+      }
+    }
+
+    /// all state of other, write region it owns is handed over and other is left without it.
+    void move_from(zero_copy_buffer& other)
+    {
+      bool owned = other.m_write_owned;
+      other.m_write_owned = false;
+      copy_from(other);
+      this->m_write_owned = owned;
+      if (owned)
+      {
+        other.set_write((unsigned char*)0, 0);
+      }
+    }
+
+    static bool gap_before(const prefix_gap& lhs, const prefix_gap& rhs)
+    {
+      return lhs.offset < rhs.offset;
+    }
+
+    /// squeeze out prefix gaps, offsets of open prefixes and borrowed bytes follow.
+    void compact_write()
+    {
+      if (this->m_gaps.empty())
+      {
+        return;
+      }
+      ::std::sort(this->m_gaps.begin(), this->m_gaps.end(), gap_before);
+      unsigned char * dest = this->m_write_header_ptr + this->m_gaps[0].offset;
+      for (::std::size_t i = 0; i < this->m_gaps.size(); ++i)
+      {
+        ::std::size_t from = this->m_gaps[i].offset + this->m_gaps[i].length;
+        ::std::size_t to = i + 1 < this->m_gaps.size() ? this->m_gaps[i + 1].offset : write_length();
+        ::std::memmove(dest, this->m_write_header_ptr + from, to - from);
+        dest += to - from;
+      }
+      this->m_write_ptr = dest;
+      // both are in offset order, as gaps are now.
+      ::std::size_t g = 0;
+      ::std::size_t shift = 0;
+      for (::std::size_t i = 0; i < this->m_open_prefixes.size(); ++i)
+      {
+        for (; g < this->m_gaps.size() && this->m_gaps[g].offset < this->m_open_prefixes[i].offset; ++g)
+        {
+          shift += this->m_gaps[g].length;
+        }
+        this->m_open_prefixes[i].offset -= shift;
+        this->m_open_prefixes[i].gap_length = 0;
+      }
+      g = 0;
+      shift = 0;
+      for (::std::size_t i = 0; i < this->m_borrowed.size(); ++i)
+      {
+        for (; g < this->m_gaps.size() && this->m_gaps[g].offset < this->m_borrowed[i].offset; ++g)
+        {
+          shift += this->m_gaps[g].length;
+        }
+        this->m_borrowed[i].offset -= shift;
+      }
+      this->m_gaps.clear();
+      this->m_gap_length = 0;
+    }
+
+    void clear_prefixes()
+    {
+      this->m_open_prefixes.clear();
+      this->m_gaps.clear();
+      this->m_gap_length = 0;
+    }
+
+    /// write region is full, squeeze out prefix gaps first, then move it to heap and grow geometrically.
+    bool grow_write(::std::size_t len)
+    {
+      if (!this->m_gaps.empty())
+      {
+        compact_write();
+        if (this->m_write_ptr + len <= this->m_write_tail_ptr)
+        {
+          return true;
+        }
+      }
+      if (!this->m_growable)
+      {
+        return false;
+      }
+      ::std::size_t length = this->m_write_ptr - this->m_write_header_ptr;
+      ::std::size_t capacity = this->m_write_tail_ptr - this->m_write_header_ptr;
+      capacity = capacity < 64 ? 64 : capacity * 2;
+      if (capacity < length + len)
+      {
+        capacity = length + len;
+      }
+      unsigned char * buffer = 0;
+      if (this->m_write_owned)
+      {
+        buffer = (unsigned char *)::std::realloc(this->m_write_header_ptr, capacity);
+      }
+      else
+      {
+        buffer = (unsigned char *)::std::malloc(capacity);
+        if (buffer && length > 0)
+        {
+          ::std::memcpy(buffer, this->m_write_header_ptr, length);
+        }
+      }
+      if (!buffer)
+      {
+        return false;
+      }
+      this->m_write_owned = true;
+      this->m_write_header_ptr = buffer;
+      this->m_write_ptr = buffer + length;
+      this->m_write_tail_ptr = buffer + capacity;
+      return true;
+    }
+
+    void free_write()
+    {
+      if (this->m_write_owned)
+      {
+        ::std::free(this->m_write_header_ptr);
+        this->m_write_owned = false;
+      }
+    }
 
   public:
     enum { good, read_overflow, write_overflow };
@@ -38,11 +250,56 @@ namespace amsg
       , m_read_tail_ptr(0)
       , m_write_tail_ptr(0)
       , m_status(good)
+      , m_single_pass(false)
+      , m_growable(false)
+      , m_write_owned(false)
+      , m_read_padded(false)
+      , m_gather_threshold(0)
+      , m_gap_length(0)
     {
     }
 
+    /// copies share read region and a write region given by set_write, a grown (heap) write
+    /// region is copied.
+    zero_copy_buffer(const zero_copy_buffer& other)
+      : basic_store(other)
+      , m_write_owned(false)
+    {
+      copy_from(other);
+    }
+
+    zero_copy_buffer(zero_copy_buffer&& other)
+      : basic_store(other)
+      , m_write_owned(false)
+    {
+      move_from(other);
+    }
+
+    zero_copy_buffer& operator = (const zero_copy_buffer& other)
+    {
+      if (this != &other)
+      {
+        free_write();
+        basic_store::operator = (other);
+        copy_from(other);
+      }
+      return *this;
+    }
+
+    zero_copy_buffer& operator = (zero_copy_buffer&& other)
+    {
+      if (this != &other)
+      {
+        free_write();
+        basic_store::operator = (other);
+        move_from(other);
+      }
+      return *this;
+    }
+
     ~zero_copy_buffer()
     {
+      free_write();
     }
 
     AMSG_INLINE void set_read(unsigned char const* buffer, ::std::size_t length)
@@ -51,6 +308,7 @@ namespace amsg
       this->m_read_ptr = this->m_read_header_ptr;
       this->m_read_tail_ptr = this->m_read_header_ptr + length;
       this->m_status = good;
+      this->reset_decode_budget();
     }
 
     AMSG_INLINE void set_read(char const* buffer, ::std::size_t length)
@@ -60,6 +318,9 @@ namespace amsg
 
     AMSG_INLINE void set_write(unsigned char* buffer, ::std::size_t length)
     {
+      free_write();
+      this->m_borrowed.clear();
+      clear_prefixes();
       this->m_write_header_ptr = buffer;
       this->m_write_ptr = this->m_write_header_ptr;
       this->m_write_tail_ptr = this->m_write_header_ptr + length;
@@ -71,9 +332,140 @@ namespace amsg
       set_write((unsigned char*)buffer, length);
     }
 
-    void append_debug_info(const char * info)
+    /// write AMSG struct in one pass, length prefix is reserved and patched after members written.
+    /// write region needs 4 bytes slack more than size_of.
+    AMSG_INLINE void set_single_pass(bool value)
+    {
+      this->m_single_pass = value;
+    }
+
+    AMSG_INLINE bool single_pass() const
+    {
+      return this->m_single_pass;
+    }
+
+    /// write region given by set_write (could be a stack buffer, or empty) spills to heap when it's full,
+    /// and grows geometrically instead of write_overflow.
+    AMSG_INLINE void set_growable(bool value)
+    {
+      this->m_growable = value;
+    }
+
+    AMSG_INLINE bool growable() const
+    {
+      return this->m_growable;
+    }
+
+    /// take written bytes without copy, caller frees them by std::free.
+    /// return 0 if bytes still in buffer given by set_write, then use write_data.
+    AMSG_INLINE unsigned char* release_write()
+    {
+      unsigned char* buffer = 0;
+      if (this->m_write_owned)
+      {
+        buffer = this->m_write_header_ptr;
+        this->m_write_owned = false;
+        set_write((unsigned char*)0, 0);
+      }
+      return buffer;
+    }
+
+    /// gather write: bytes (string data) not less than threshold are referenced instead of copied,
+    /// they must live until write_iovec's output is sent. 0 disable.
+    AMSG_INLINE void set_gather(::std::size_t threshold)
+    {
+      this->m_gather_threshold = threshold;
+    }
+
+    AMSG_INLINE ::std::size_t gather() const
+    {
+      return this->m_gather_threshold;
+    }
+
+    ::std::size_t write_borrowed(const char * buffer, ::std::size_t len)
+    {
+      if (this->m_gather_threshold == 0 || len < this->m_gather_threshold)
+      {
+        return write(buffer, len);
+      }
+      borrowed_segment segment;
+      segment.offset = this->m_write_ptr - this->m_write_header_ptr;
+      segment.data = (unsigned char const*)buffer;
+      segment.length = len;
+      this->m_borrowed.push_back(segment);
+      return len;
+    }
+
+    /// borrowed bytes after offset of write region.
+    AMSG_INLINE ::std::size_t borrowed_length(::std::size_t offset) const
+    {
+      ::std::size_t length = 0;
+      for (::std::size_t i = this->m_borrowed.size(); i > 0 && this->m_borrowed[i - 1].offset > offset; --i)
+      {
+        length += this->m_borrowed[i - 1].length;
+      }
+      return length;
+    }
+
+    /// written bytes include borrowed.
+    AMSG_INLINE ::std::size_t gather_length() const
+    {
+      ::std::size_t length = write_length();
+      for (::std::size_t i = 0; i < this->m_borrowed.size(); ++i)
+      {
+        length += this->m_borrowed[i].length;
+      }
+      return length;
+    }
+
+#ifndef _WIN32
+    /// fill vec with written bytes and borrowed bytes in order, ready for writev/sendmsg.
+    /// return count of iovec needed, only count of them filled.
+    ::std::size_t write_iovec(::iovec * vec, ::std::size_t count) const
+    {
+      ::std::size_t n = 0;
+      ::std::size_t pos = 0;
+      for (::std::size_t i = 0; i < this->m_borrowed.size(); ++i)
+      {
+        const borrowed_segment& segment = this->m_borrowed[i];
+        if (segment.offset > pos)
+        {
+          if (n < count)
+          {
+            vec[n].iov_base = this->m_write_header_ptr + pos;
+            vec[n].iov_len = segment.offset - pos;
+          }
+          ++n;
+          pos = segment.offset;
+        }
+        if (n < count)
+        {
+          vec[n].iov_base = (void*)segment.data;
+          vec[n].iov_len = segment.length;
+        }
+        ++n;
+      }
+      if (write_length() > pos)
+      {
+        if (n < count)
+        {
+          vec[n].iov_base = this->m_write_header_ptr + pos;
+          vec[n].iov_len = write_length() - pos;
+        }
+        ++n;
+      }
+      return n;
+    }
+#endif
+
+    /// error field path as text, built when asked.
+    const ::std::string& info() const
     {
-      m_error_info.append(info);
+      m_error_info.clear();
+#ifndef AMSG_NO_ERROR_PATH
+      this->error_path().append_to(m_error_info);
+#endif
+      return m_error_info;
     }
 
     ::std::size_t read(char * buffer, ::std::size_t len)
@@ -100,7 +492,7 @@ namespace amsg
 
     ::std::size_t write(const char * buffer, ::std::size_t len)
     {
-      if (this->m_write_ptr + len > this->m_write_tail_ptr)
+      if (this->m_write_ptr + len > this->m_write_tail_ptr && !grow_write(len))
       {
         this->m_status = write_overflow;
         return 0;
@@ -114,7 +506,7 @@ namespace amsg
 
     AMSG_INLINE unsigned char * append_write(::std::size_t len)
     {
-      if (this->m_write_ptr + len > this->m_write_tail_ptr)
+      if (this->m_write_ptr + len > this->m_write_tail_ptr && !grow_write(len))
       {
         this->m_status = write_overflow;
         return 0;
@@ -124,6 +516,17 @@ namespace amsg
       return append_ptr;
     }
 
+    /// make sure len bytes could be written at write_ptr without moving it, grow if growable.
+    /// return 0 if not enough, status unchanged.
+    AMSG_INLINE unsigned char * reserve_write(::std::size_t len)
+    {
+      if (this->m_write_ptr + len > this->m_write_tail_ptr && !grow_write(len))
+      {
+        return 0;
+      }
+      return this->m_write_ptr;
+    }
+
     AMSG_INLINE unsigned char const* skip_read(::std::size_t len)
     {
       if (this->m_read_ptr + len > this->m_read_tail_ptr)
@@ -140,6 +543,8 @@ namespace amsg
     {
       basic_store::clear();
       this->m_write_ptr = this->m_write_header_ptr;
+      this->m_borrowed.clear();
+      clear_prefixes();
     }
 
     AMSG_INLINE void clear()
@@ -147,6 +552,8 @@ namespace amsg
       basic_store::clear();
       this->m_read_ptr = this->m_read_header_ptr;
       this->m_write_ptr = this->m_write_header_ptr;
+      this->m_borrowed.clear();
+      clear_prefixes();
       m_status = good;
     }
 
@@ -155,6 +562,35 @@ namespace amsg
       return this->m_read_ptr;
     }
 
+    /// caller promises 8 readable bytes after read region, so integers are decoded by
+    /// unaligned 8 bytes load even at the end of region.
+    AMSG_INLINE void set_read_padded(bool value)
+    {
+      this->m_read_padded = value;
+    }
+
+    AMSG_INLINE bool read_padded() const
+    {
+      return this->m_read_padded;
+    }
+
+    /// move read_ptr without bound check, caller checked read_remain.
+    AMSG_INLINE void advance_read(::std::size_t len)
+    {
+      this->m_read_ptr += len;
+    }
+
+    /// move write_ptr after bytes written at reserve_write, unchecked.
+    AMSG_INLINE void advance_write(::std::size_t len)
+    {
+      this->m_write_ptr += len;
+    }
+
+    AMSG_INLINE ::std::size_t read_remain() const
+    {
+      return this->m_read_tail_ptr - this->m_read_ptr;
+    }
+
     AMSG_INLINE unsigned char* write_ptr() const
     {
       return this->m_write_ptr;
@@ -174,6 +610,11 @@ namespace amsg
     {
       return this->m_write_ptr - this->m_write_header_ptr;
     }
+
+    AMSG_INLINE::std::size_t write_capacity() const
+    {
+      return this->m_write_tail_ptr - this->m_write_header_ptr;
+    }
   };
 
   template<std::size_t size>
@@ -260,300 +701,87 @@ namespace amsg
   };
 #endif
 
+  /// tag and value bytes with one bound check, value bytes by one unaligned 8 bytes load
+  /// when 8 bytes after tag are readable (or read region is padded).
   template<typename value_type>
-  AMSG_INLINE
-    typename ::std::enable_if<::std::is_signed<value_type>::value && ::std::is_integral<value_type>::value, void>::type
-    read(zero_copy_buffer& stream, value_type& value)
+  AMSG_INLINE void read_integer(zero_copy_buffer& stream, value_type& value)
   {
     const int bytes = sizeof(value_type);
-    uint8_t tag = stream.get_char();
-    if (stream.bad())
+    uint8_t const* ptr = stream.read_ptr();
+    ::std::size_t remain = stream.read_remain();
+    if (remain == 0)
     {
+      stream.skip_read(1);
       stream.m_error_code = stream_buffer_overflow;
       return;
     }
-    if (tag > const_tag_as_value)
+    uint8_t tag = *ptr;
+    if (tag <= const_tag_as_value)
     {
-      int sign = 1;
-      if ((long)tag & const_negative_bit_value)
-      {
-        sign = -1;
-      }
-      int read_bytes = (int(tag) & const_interger_byte_msak) + 1;
-      if (bytes < read_bytes)
-      {
-        stream.m_error_code = value_too_large_to_integer_number;
-        return;
-      }
-      value = 0;
-      uint8_t const* read_ptr = stream.skip_read(read_bytes);
-      if (stream.bad())
-      {
-        stream.m_error_code = stream_buffer_overflow;
-        return;
-      }
-      uint8_t * value_ptr = (uint8_t *)&value;
-      value = 0;
-      switch (read_bytes)
-      {
-      case 8:value_ptr[7] = read_ptr[le_pos<bytes>::pos7];
-      case 7:value_ptr[6] = read_ptr[le_pos<bytes>::pos6];
-      case 6:value_ptr[5] = read_ptr[le_pos<bytes>::pos5];
-      case 5:value_ptr[4] = read_ptr[le_pos<bytes>::pos4];
-      case 4:value_ptr[3] = read_ptr[le_pos<bytes>::pos3];
-      case 3:value_ptr[2] = read_ptr[le_pos<bytes>::pos2];
-      case 2:value_ptr[1] = read_ptr[le_pos<bytes>::pos1];
-      case 1:value_ptr[0] = read_ptr[le_pos<bytes>::pos0];
-      }
-      if (sign < 0)
-      {
-        value = -value;
-      }
+      value = (value_type)tag;
+      stream.advance_read(1);
+      return;
     }
-    else
+    if (!::std::is_signed<value_type>::value && (tag & const_negative_bit_value))
     {
-      value = tag;
+      stream.m_error_code = negative_assign_to_unsigned_integer_number;
+      return;
     }
-  }
-
-  template<typename value_type>
-  AMSG_INLINE
-    typename ::std::enable_if<::std::is_signed<value_type>::value && ::std::is_integral<value_type>::value, void>::type
-    write(zero_copy_buffer& stream, const value_type& value)
-  {
-    const int bytes = sizeof(value_type);
-    int write_bytes = 1;
-    uint8_t write_buff[12];
-    if (0 <= value && value < const_tag_as_type)
+    ::std::size_t read_bytes = (tag & const_interger_byte_msak) + 1;
+    if (bytes < (int)read_bytes)
+    {
+      stream.m_error_code = value_too_large_to_integer_number;
+      return;
+    }
+    if (remain <= read_bytes)
+    {
+      stream.skip_read(remain + 1);
+      stream.m_error_code = stream_buffer_overflow;
+      return;
+    }
+    uint64_t temp = 0;
+    if (remain > 8 || stream.read_padded())
     {
-      write_buff[0] = (uint8_t)value;
+      ::std::memcpy(&temp, ptr + 1, 8);
+      temp = little_endian_to_host64(temp) & (~0ULL >> (64 - read_bytes * 8));
     }
     else
     {
-      uint8_t negative_bit = 0;
-      value_type temp = value;
-      if (value < 0)
-      {
-        negative_bit = const_negative_bit_value;
-        temp = -value;
-      }
-      uint8_t * ptr = (uint8_t *)&temp;
-      if (temp < 0x100)
+      for (::std::size_t i = 0; i < read_bytes; ++i)
       {
-        write_buff[1] = ptr[le_pos<bytes>::pos0];
-        write_bytes = 2;
+        temp |= (uint64_t)ptr[1 + i] << (i * 8);
       }
-      else if (temp < 0x10000)
-      {
-        write_buff[1] = ptr[le_pos<bytes>::pos0];
-        write_buff[2] = ptr[le_pos<bytes>::pos1];
-        write_bytes = 3;
-      }
-      else if (temp < 0x1000000)
-      {
-        write_buff[1] = ptr[le_pos<bytes>::pos0];
-        write_buff[2] = ptr[le_pos<bytes>::pos1];
-        write_buff[3] = ptr[le_pos<bytes>::pos2];
-        write_bytes = 4;
-      }
-      else if (temp < 0x100000000)
-      {
-        write_buff[1] = ptr[le_pos<bytes>::pos0];
-        write_buff[2] = ptr[le_pos<bytes>::pos1];
-        write_buff[3] = ptr[le_pos<bytes>::pos2];
-        write_buff[4] = ptr[le_pos<bytes>::pos3];
-        write_bytes = 5;
-      }
-      else if (temp < 0x10000000000)
-      {
-        write_buff[1] = ptr[le_pos<bytes>::pos0];
-        write_buff[2] = ptr[le_pos<bytes>::pos1];
-        write_buff[3] = ptr[le_pos<bytes>::pos2];
-        write_buff[4] = ptr[le_pos<bytes>::pos3];
-        write_buff[5] = ptr[le_pos<bytes>::pos4];
-        write_bytes = 6;
-      }
-      else if (temp < 0x1000000000000)
-      {
-        write_buff[1] = ptr[le_pos<bytes>::pos0];
-        write_buff[2] = ptr[le_pos<bytes>::pos1];
-        write_buff[3] = ptr[le_pos<bytes>::pos2];
-        write_buff[4] = ptr[le_pos<bytes>::pos3];
-        write_buff[5] = ptr[le_pos<bytes>::pos4];
-        write_buff[6] = ptr[le_pos<bytes>::pos5];
-        write_bytes = 7;
-      }
-      else if (temp < 0x100000000000000)
-      {
-        write_buff[1] = ptr[le_pos<bytes>::pos0];
-        write_buff[2] = ptr[le_pos<bytes>::pos1];
-        write_buff[3] = ptr[le_pos<bytes>::pos2];
-        write_buff[4] = ptr[le_pos<bytes>::pos3];
-        write_buff[5] = ptr[le_pos<bytes>::pos4];
-        write_buff[6] = ptr[le_pos<bytes>::pos5];
-        write_buff[7] = ptr[le_pos<bytes>::pos6];
-        write_bytes = 8;
-      }
-      else
-      {
-        write_buff[1] = ptr[le_pos<bytes>::pos0];
-        write_buff[2] = ptr[le_pos<bytes>::pos1];
-        write_buff[3] = ptr[le_pos<bytes>::pos2];
-        write_buff[4] = ptr[le_pos<bytes>::pos3];
-        write_buff[5] = ptr[le_pos<bytes>::pos4];
-        write_buff[6] = ptr[le_pos<bytes>::pos5];
-        write_buff[7] = ptr[le_pos<bytes>::pos6];
-        write_buff[8] = ptr[le_pos<bytes>::pos7];
-        write_bytes = 9;
-      }
-      write_buff[0] = (uint8_t)(const_store_postive_integer_byte_mask + negative_bit + write_bytes);
     }
-    stream.write((char*)write_buff, write_bytes);
-    if (stream.bad())
+    if (tag & const_negative_bit_value)
     {
-      stream.m_error_code = stream_buffer_overflow;
-      return;
+      temp = 0 - temp;
     }
+    value = (value_type)temp;
+    stream.advance_read(1 + read_bytes);
   }
 
   template<typename value_type>
   AMSG_INLINE
-    typename ::std::enable_if<::std::is_unsigned<value_type>::value && ::std::is_integral<value_type>::value, void>::type
+    typename ::std::enable_if<::std::is_signed<value_type>::value && ::std::is_integral<value_type>::value, void>::type
     read(zero_copy_buffer& stream, value_type& value)
   {
-    const int bytes = sizeof(value_type);
-    value = stream.get_char();
-    if (stream.bad())
-    {
-      stream.m_error_code = stream_buffer_overflow;
-      return;
-    }
-    if (value > const_tag_as_value)
-    {
-      if ((long)value & const_negative_bit_value)
-      {
-        stream.m_error_code = negative_assign_to_unsigned_integer_number;
-        return;
-      }
-      int read_bytes = (int)(value & const_interger_byte_msak) + 1;
-      if (bytes < read_bytes)
-      {
-        stream.m_error_code = value_too_large_to_integer_number;
-        return;
-      }
-      uint8_t const* read_ptr = stream.skip_read(read_bytes);
-      if (stream.bad())
-      {
-        stream.m_error_code = stream_buffer_overflow;
-        return;
-      }
-      uint8_t * value_ptr = (uint8_t *)&value;
-      value = 0;
-      switch (read_bytes)
-      {
-      case 8:value_ptr[7] = read_ptr[le_pos<bytes>::pos7];
-      case 7:value_ptr[6] = read_ptr[le_pos<bytes>::pos6];
-      case 6:value_ptr[5] = read_ptr[le_pos<bytes>::pos5];
-      case 5:value_ptr[4] = read_ptr[le_pos<bytes>::pos4];
-      case 4:value_ptr[3] = read_ptr[le_pos<bytes>::pos3];
-      case 3:value_ptr[2] = read_ptr[le_pos<bytes>::pos2];
-      case 2:value_ptr[1] = read_ptr[le_pos<bytes>::pos1];
-      case 1:value_ptr[0] = read_ptr[le_pos<bytes>::pos0];
-      }
-    }
+    read_integer(stream, value);
   }
 
   template<typename value_type>
   AMSG_INLINE
-    typename ::std::enable_if<::std::is_unsigned<value_type>::value && ::std::is_integral<value_type>::value, void>::type
+    typename ::std::enable_if<::std::is_integral<value_type>::value && !::std::is_same<value_type, bool>::value, void>::type
     write(zero_copy_buffer& stream, const value_type& value)
   {
-    const int bytes = sizeof(value_type);
-    if (value < const_tag_as_type)
+    uint8_t * ptr = stream.reserve_write(9);
+    if (ptr)
     {
-      uint8_t * ptr = stream.append_write(1);
-      *ptr = (uint8_t)value;
-    }
-    else
-    {
-      uint8_t * ptr = (uint8_t *)(&value);
-      if (value < 0x100)
-      {
-        uint8_t * wptr = stream.append_write(2);
-        wptr[0] = 0x80;
-        wptr[1] = ptr[le_pos<bytes>::pos0];
-      }
-      else if (value < 0x10000)
-      {
-        uint8_t * wptr = stream.append_write(3);
-        wptr[0] = 0x81;
-        wptr[1] = ptr[le_pos<bytes>::pos0];
-        wptr[2] = ptr[le_pos<bytes>::pos1];
-      }
-      else if (value < 0x1000000)
-      {
-        uint8_t * wptr = stream.append_write(4);
-        wptr[0] = 0x82;
-        wptr[1] = ptr[le_pos<bytes>::pos0];
-        wptr[2] = ptr[le_pos<bytes>::pos1];
-        wptr[3] = ptr[le_pos<bytes>::pos2];
-      }
-      else if (value < 0x100000000)
-      {
-        uint8_t * wptr = stream.append_write(5);
-        wptr[0] = 0x83;
-        wptr[1] = ptr[le_pos<bytes>::pos0];
-        wptr[2] = ptr[le_pos<bytes>::pos1];
-        wptr[3] = ptr[le_pos<bytes>::pos2];
-        wptr[4] = ptr[le_pos<bytes>::pos3];
-      }
-      else if (value < 0x10000000000LL)
-      {
-        uint8_t * wptr = stream.append_write(6);
-        wptr[0] = 0x84;
-        wptr[1] = ptr[le_pos<bytes>::pos0];
-        wptr[2] = ptr[le_pos<bytes>::pos1];
-        wptr[3] = ptr[le_pos<bytes>::pos2];
-        wptr[4] = ptr[le_pos<bytes>::pos3];
-        wptr[5] = ptr[le_pos<bytes>::pos4];
-      }
-      else if (value < 0x1000000000000LL)
-      {
-        uint8_t * wptr = stream.append_write(7);
-        wptr[0] = 0x85;
-        wptr[1] = ptr[le_pos<bytes>::pos0];
-        wptr[2] = ptr[le_pos<bytes>::pos1];
-        wptr[3] = ptr[le_pos<bytes>::pos2];
-        wptr[4] = ptr[le_pos<bytes>::pos3];
-        wptr[5] = ptr[le_pos<bytes>::pos4];
-        wptr[6] = ptr[le_pos<bytes>::pos5];
-      }
-      else if (value < 0x100000000000000LL)
-      {
-        uint8_t * wptr = stream.append_write(8);
-        wptr[0] = 0x86;
-        wptr[1] = ptr[le_pos<bytes>::pos0];
-        wptr[2] = ptr[le_pos<bytes>::pos1];
-        wptr[3] = ptr[le_pos<bytes>::pos2];
-        wptr[4] = ptr[le_pos<bytes>::pos3];
-        wptr[5] = ptr[le_pos<bytes>::pos4];
-        wptr[6] = ptr[le_pos<bytes>::pos5];
-        wptr[7] = ptr[le_pos<bytes>::pos6];
-      }
-      else
-      {
-        uint8_t * wptr = stream.append_write(9);
-        wptr[0] = 0x87;
-        wptr[1] = ptr[le_pos<bytes>::pos0];
-        wptr[2] = ptr[le_pos<bytes>::pos1];
-        wptr[3] = ptr[le_pos<bytes>::pos2];
-        wptr[4] = ptr[le_pos<bytes>::pos3];
-        wptr[5] = ptr[le_pos<bytes>::pos4];
-        wptr[6] = ptr[le_pos<bytes>::pos5];
-        wptr[7] = ptr[le_pos<bytes>::pos6];
-        wptr[8] = ptr[le_pos<bytes>::pos7];
-      }
+      stream.advance_write(encode_integer(ptr, value) - ptr);
+      return;
     }
+    uint8_t write_buff[16];
+    uint8_t * end = encode_integer(write_buff, value);
+    stream.write((char*)write_buff, end - write_buff);
     if (stream.bad())
     {
       stream.m_error_code = stream_buffer_overflow;
@@ -561,6 +789,14 @@ namespace amsg
     }
   }
 
+  template<typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<::std::is_unsigned<value_type>::value && ::std::is_integral<value_type>::value && !::std::is_same<value_type, bool>::value, void>::type
+    read(zero_copy_buffer& stream, value_type& value)
+  {
+    read_integer(stream, value);
+  }
+
   template<typename value_type>
   AMSG_INLINE
     typename ::std::enable_if<::std::is_integral<value_type>::value, void>::type
@@ -685,6 +921,722 @@ namespace amsg
     write_ptr[le_pos<8>::pos7] = value_ptr[7];
   }
 
+  /// batch codec of integer sequence, same format as integer read/write one by one.
+  template<typename value_type>
+  struct is_batch_integer
+    : public ::std::integral_constant<bool, ::std::is_integral<value_type>::value && !::std::is_same<value_type, bool>::value>{};
+
+  template<typename value_type, typename iter_ty>
+  AMSG_INLINE void read_integers(zero_copy_buffer& stream, iter_ty iter, uint32_t len)
+  {
+    const int bytes = sizeof(value_type);
+    uint8_t const* begin = stream.read_ptr();
+    uint8_t const* ptr = begin;
+    uint8_t const* tail = begin + stream.read_remain();
+    uint32_t c = 0;
+    while (c < len)
+    {
+#ifdef AMSG_SSE2
+      // copy a run of values stored in tag, bytes less than 0x80.
+      if (tail - ptr >= 16 && len - c >= 16)
+      {
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((__m128i const*)ptr));
+        int run = mask == 0 ? 16 : count_trailing_zeros(mask);
+        for (int i = 0; i < run; ++i, ++iter)
+        {
+          *iter = (value_type)ptr[i];
+        }
+        ptr += run;
+        c += run;
+        if (run == 16)
+        {
+          continue;
+        }
+      }
+#endif
+      if (ptr >= tail)
+      {
+        stream.set_error_code(stream_buffer_overflow);
+        break;
+      }
+      uint8_t tag = *ptr;
+      if (tag <= const_tag_as_value)
+      {
+        *iter = (value_type)tag;
+        ++iter;
+        ++ptr;
+        ++c;
+        continue;
+      }
+      if (!::std::is_signed<value_type>::value && (tag & const_negative_bit_value))
+      {
+        stream.set_error_code(negative_assign_to_unsigned_integer_number);
+        break;
+      }
+      int read_bytes = (tag & const_interger_byte_msak) + 1;
+      if (bytes < read_bytes)
+      {
+        stream.set_error_code(value_too_large_to_integer_number);
+        break;
+      }
+      if (tail - ptr <= read_bytes)
+      {
+        stream.set_error_code(stream_buffer_overflow);
+        break;
+      }
+      uint64_t temp = 0;
+      if (tail - ptr > 8 || stream.read_padded())
+      {
+        ::std::memcpy(&temp, ptr + 1, 8);
+        temp = little_endian_to_host64(temp);
+        if (read_bytes < 8)
+        {
+          temp &= (1ULL << (read_bytes * 8)) - 1;
+        }
+      }
+      else
+      {
+        for (int i = 0; i < read_bytes; ++i)
+        {
+          temp |= (uint64_t)ptr[1 + i] << (i * 8);
+        }
+      }
+      value_type value = (value_type)temp;
+      if (tag & const_negative_bit_value)
+      {
+        value = (value_type)(0 - value);
+      }
+      *iter = value;
+      ++iter;
+      ptr += 1 + read_bytes;
+      ++c;
+    }
+    stream.skip_read(ptr - begin);
+    if (c < len)
+    {
+      AMSG_ERROR_INDEX(stream, c);
+    }
+  }
+
+  template<typename value_type, typename iter_ty>
+  AMSG_INLINE void write_integers(zero_copy_buffer& stream, iter_ty iter, uint32_t len)
+  {
+    uint8_t * begin = stream.reserve_write((::std::size_t)len * (1 + sizeof(value_type)) + 8);
+    if (begin)
+    {
+      // enough for the worst, no bound check for every value.
+      // encode_integer stores 8 bytes, so 8 more bytes reserved.
+      uint8_t * ptr = begin;
+      for (uint32_t c = 0; c < len; ++c, ++iter)
+      {
+        ptr = encode_integer<value_type>(ptr, *iter);
+      }
+      stream.append_write(ptr - begin);
+      return;
+    }
+    for (uint32_t c = 0; c < len; ++c, ++iter)
+    {
+      write(stream, *iter);
+      if (stream.error())
+      {
+        AMSG_ERROR_INDEX(stream, c);
+        return;
+      }
+    }
+  }
+
+  template<typename value_type, typename alloc_ty>
+  AMSG_INLINE
+    typename ::std::enable_if<is_batch_integer<value_type>::value, void>::type
+    read(zero_copy_buffer& stream, ::std::vector<value_type, alloc_ty>& value, uint32_t max = 0)
+  {
+    uint32_t len = 0;
+    read(stream, len);
+    if (stream.error())
+    {
+      return;
+    }
+    if (max > 0 && max < len)
+    {
+      stream.set_error_code(sequence_length_overflow);
+      return;
+    }
+    // every value takes at least one byte
+    if (len > stream.read_remain())
+    {
+      stream.set_error_code(stream_buffer_overflow);
+      return;
+    }
+    if (!stream.charge_decode(len, (uint64_t)len * sizeof(value_type)))
+    {
+      return;
+    }
+    value.resize(len);
+    if (len > 0)
+    {
+      read_integers<value_type>(stream, &value[0], len);
+    }
+  }
+
+  template<typename value_type, typename alloc_ty>
+  AMSG_INLINE
+    typename ::std::enable_if<is_batch_integer<value_type>::value, void>::type
+    read(zero_copy_buffer& stream, ::std::deque<value_type, alloc_ty>& value, uint32_t max = 0)
+  {
+    uint32_t len = 0;
+    read(stream, len);
+    if (stream.error())
+    {
+      return;
+    }
+    if (max > 0 && max < len)
+    {
+      stream.set_error_code(sequence_length_overflow);
+      return;
+    }
+    if (len > stream.read_remain())
+    {
+      stream.set_error_code(stream_buffer_overflow);
+      return;
+    }
+    if (!stream.charge_decode(len, (uint64_t)len * sizeof(value_type)))
+    {
+      return;
+    }
+    value.resize(len);
+    read_integers<value_type>(stream, value.begin(), len);
+  }
+
+  template<typename value_type, typename alloc_ty>
+  AMSG_INLINE
+    typename ::std::enable_if<is_batch_integer<value_type>::value, void>::type
+    write(zero_copy_buffer& stream, const ::std::vector<value_type, alloc_ty>& value, uint32_t max = 0)
+  {
+    uint32_t len = (uint32_t)value.size();
+    if (max > 0 && max < len)
+    {
+      stream.set_error_code(sequence_length_overflow);
+      return;
+    }
+    write(stream, len);
+    if (stream.bad())
+    {
+      stream.set_error_code(stream_buffer_overflow);
+      return;
+    }
+    if (len > 0)
+    {
+      write_integers<value_type>(stream, &value[0], len);
+    }
+  }
+
+  template<typename value_type, typename alloc_ty>
+  AMSG_INLINE
+    typename ::std::enable_if<is_batch_integer<value_type>::value, void>::type
+    write(zero_copy_buffer& stream, const ::std::deque<value_type, alloc_ty>& value, uint32_t max = 0)
+  {
+    uint32_t len = (uint32_t)value.size();
+    if (max > 0 && max < len)
+    {
+      stream.set_error_code(sequence_length_overflow);
+      return;
+    }
+    write(stream, len);
+    if (stream.bad())
+    {
+      stream.set_error_code(stream_buffer_overflow);
+      return;
+    }
+    write_integers<value_type>(stream, value.begin(), len);
+  }
+
+  AMSG_INLINE ::std::size_t write_raw(zero_copy_buffer& stream, const char * buffer, ::std::size_t len)
+  {
+    return stream.write_borrowed(buffer, len);
+  }
+
+  /// view points into read region of stream, no copy, no allocation.
+  template<typename value_type>
+  AMSG_INLINE
+    typename ::std::enable_if<is_bytes_view<value_type>::value, void>::type
+    read(zero_copy_buffer& stream, value_type& value, uint32_t max = 0)
+  {
+    uint32_t len = 0;
+    read(stream, len);
+    if (stream.error())
+    {
+      return;
+    }
+    if (max > 0 && max < len)
+    {
+      stream.set_error_code(sequence_length_overflow);
+      return;
+    }
+    uint8_t const* read_ptr = stream.skip_read(len);
+    if (stream.bad())
+    {
+      stream.set_error_code(stream_buffer_overflow);
+      return;
+    }
+    value = value_type((char const*)read_ptr, len);
+  }
+
+  AMSG_INLINE ::std::size_t read_remain(const zero_copy_buffer& stream)
+  {
+    return stream.read_remain();
+  }
+
+  AMSG_INLINE bool single_pass(const zero_copy_buffer& stream)
+  {
+    return stream.single_pass();
+  }
+
+  /// returns index of prefix reserved (or none if it fails), end_length_prefix takes it back.
+  AMSG_INLINE ::std::size_t begin_length_prefix(zero_copy_buffer& stream)
+  {
+    // borrowed bytes are not in write region, with gather its capacity does not bound the size.
+    // prefix gaps are room too, they are squeezed out before region is short.
+    ::std::size_t remain = stream.growable() || stream.gather() ? 0xffffffff :
+      stream.write_capacity() - stream.write_length() + stream.m_gap_length;
+    uint32_t max_size = remain < 0xffffffff ? (uint32_t)remain : 0xffffffff;
+    uint8_t prefix_bytes = (uint8_t)size_of(max_size);
+    uint8_t * ptr = stream.append_write(prefix_bytes);
+    if (stream.bad())
+    {
+      stream.m_error_code = stream_buffer_overflow;
+      return stream.m_open_prefixes.size();
+    }
+    zero_copy_buffer::open_prefix prefix;
+    prefix.offset = ptr - stream.write_data();
+    prefix.length = prefix_bytes;
+    prefix.gap_length = stream.m_gap_length;
+    stream.m_open_prefixes.push_back(prefix);
+    return stream.m_open_prefixes.size() - 1;
+  }
+
+  AMSG_INLINE void end_length_prefix(zero_copy_buffer& stream, ::std::size_t index)
+  {
+    if (index >= stream.m_open_prefixes.size())
+    {
+      return;
+    }
+    zero_copy_buffer::open_prefix prefix = stream.m_open_prefixes[index];
+    stream.m_open_prefixes.resize(index);
+    uint32_t size = (uint32_t)(stream.write_length() - prefix.offset - prefix.length -
+      (stream.m_gap_length - prefix.gap_length) + stream.borrowed_length(prefix.offset));
+    size += size_of(size + size_of(size));
+    uint32_t size_bytes = size_of(size);
+    if (size_bytes > prefix.length)
+    {
+      stream.m_error_code = stream_buffer_overflow;
+      return;
+    }
+    zero_copy_buffer writer;
+    writer.set_write(stream.write_data() + prefix.offset, size_bytes);
+    write(writer, size);
+    if (size_bytes < prefix.length)
+    {
+      zero_copy_buffer::prefix_gap gap;
+      gap.offset = prefix.offset + size_bytes;
+      gap.length = prefix.length - size_bytes;
+      stream.m_gaps.push_back(gap);
+      stream.m_gap_length += gap.length;
+    }
+    if (stream.m_open_prefixes.empty())
+    {
+      stream.compact_write();
+    }
+  }
+
+  AMSG_INLINE unsigned char * unchecked_write_begin(zero_copy_buffer& stream, ::std::size_t len)
+  {
+    // gather keeps large bytes out of write region, they must go through write_raw.
+    if (stream.gather())
+    {
+      return 0;
+    }
+    return stream.reserve_write(len + 8);
+  }
+
+  AMSG_INLINE void unchecked_write_end(zero_copy_buffer& stream, ::std::size_t len)
+  {
+    stream.advance_write(len);
+  }
+
+  template<typename value_type>
+  class sequence_view;
+
+  /// lazy view over one encoded AMSG struct, nothing is decoded until asked:
+  /// member offsets are found on first access by skipping members once,
+  /// get decodes one member, sub_view and sequence look into nested structs without decoding them.
+  /// data must outlive the view.
+  template<typename value_type>
+  class view
+  {
+  public:
+    view()
+      : m_data(0)
+      , m_length(0)
+    {
+      reset();
+    }
+
+    view(unsigned char const* data, ::std::size_t length)
+      : m_data(data)
+      , m_length(length)
+    {
+      reset();
+    }
+
+    AMSG_INLINE bool empty() const
+    {
+      return m_data == 0;
+    }
+
+    AMSG_INLINE unsigned char const* data() const
+    {
+      return m_data;
+    }
+
+    /// encoded struct size, length prefix included.
+    AMSG_INLINE ::std::size_t length() const
+    {
+      index();
+      return m_offsets[member_count];
+    }
+
+    AMSG_INLINE error_code_t error_code() const
+    {
+      index();
+      return m_error_code;
+    }
+
+    AMSG_INLINE bool error() const
+    {
+      return error_code() != success;
+    }
+
+    AMSG_INLINE uint64_t tag() const
+    {
+      index();
+      return m_tag;
+    }
+
+    /// true if member was written (not default).
+    template<typename member_ty>
+    AMSG_INLINE bool has(member_ty value_type::* member) const
+    {
+      uint32_t i = member_index(member);
+      return i < member_count && (tag() & (1ULL << i)) != 0;
+    }
+
+    /// decode one member into a member_ty of its own, absent member is default.
+    /// member is a runtime pointer (get(&T::member)) rather than a template argument
+    /// (get<&T::member>()), so it works on C++11 without spelling member's type.
+    template<typename member_ty>
+    member_ty get(member_ty value_type::* member) const
+    {
+      member_ty value = member_ty();
+      uint32_t i = member_index(member);
+      if (has(member))
+      {
+        zero_copy_buffer reader;
+        reader.set_read(m_data + m_offsets[i], m_offsets[i + 1] - m_offsets[i]);
+        struct_traits<value_type>::read_member(reader, probe(), value, i);
+        if (reader.error())
+        {
+          m_error_code = reader.error_code();
+        }
+      }
+      return value;
+    }
+
+    /// nested AMSG struct member, empty if absent.
+    template<typename member_ty>
+    view<member_ty> sub_view(member_ty value_type::* member) const
+    {
+      static_assert(struct_traits<member_ty>::value, "amsg::view::sub_view: member is not an AMSG struct.");
+      if (!has(member))
+      {
+        return view<member_ty>();
+      }
+      uint32_t i = member_index(member);
+      return view<member_ty>(m_data + m_offsets[i], m_offsets[i + 1] - m_offsets[i]);
+    }
+
+    /// vector of AMSG structs member, elements are views found on demand (by offset table if sidx).
+    template<typename elem_ty, typename alloc_ty>
+    sequence_view<elem_ty> sequence(::std::vector<elem_ty, alloc_ty> value_type::* member) const
+    {
+      static_assert(struct_traits<elem_ty>::value, "amsg::view::sequence: element is not an AMSG struct.");
+      if (!has(member))
+      {
+        return sequence_view<elem_ty>();
+      }
+      uint32_t i = member_index(member);
+      return sequence_view<elem_ty>(m_data + m_offsets[i], m_offsets[i + 1] - m_offsets[i],
+        struct_traits<value_type>::indexed_member(i));
+    }
+
+  private:
+    enum { member_count = struct_traits<value_type>::member_count };
+
+    AMSG_INLINE void reset()
+    {
+      m_tag = 0;
+      m_indexed = false;
+      m_error_code = success;
+      m_offsets[member_count] = 0;
+    }
+
+    AMSG_INLINE static value_type const& probe()
+    {
+      static value_type const value = value_type();
+      return value;
+    }
+
+    template<typename member_ty>
+    AMSG_INLINE static uint32_t member_index(member_ty value_type::* member)
+    {
+      uint64_t field = field_of(probe(), probe().*member);
+      return field == 0 ? (uint32_t)member_count : (uint32_t)(63 - count_leading_zeros(field));
+    }
+
+    void index() const
+    {
+      if (m_indexed)
+      {
+        return;
+      }
+      m_indexed = true;
+      for (uint32_t i = 0; i <= member_count; ++i)
+      {
+        m_offsets[i] = 0;
+      }
+      if (m_data == 0)
+      {
+        return;
+      }
+      zero_copy_buffer reader;
+      reader.set_read(m_data, m_length);
+      uint32_t len_tag = 0;
+      read(reader, len_tag);
+      if (!reader.error() && len_tag > m_length)
+      {
+        reader.set_error_code(stream_buffer_overflow);
+      }
+      if (!reader.error())
+      {
+        // members must not run past the struct's own length.
+        reader.set_read(m_data, len_tag);
+        read(reader, len_tag);
+        read(reader, m_tag);
+      }
+      if (!reader.error())
+      {
+        struct_traits<value_type>::member_offsets(reader, m_tag, m_offsets);
+      }
+      if (reader.error())
+      {
+        m_tag = 0;
+        m_error_code = reader.error_code();
+        for (uint32_t i = 0; i <= member_count; ++i)
+        {
+          m_offsets[i] = 0;
+        }
+        return;
+      }
+      // members unknown to this side (newer writer) end where struct ends.
+      m_offsets[member_count] = len_tag;
+    }
+
+    unsigned char const* m_data;
+    ::std::size_t m_length;
+    mutable uint64_t m_tag;
+    mutable bool m_indexed;
+    mutable error_code_t m_error_code;
+    mutable uint32_t m_offsets[member_count + 1];
+  };
+
+  /// encoded vector of AMSG structs, element offsets are found by length prefixes as far as accessed.
+  /// a sidx sequence is seeked by its offset table instead, skipping at most stride - 1 elements.
+  template<typename value_type>
+  class sequence_view
+  {
+  public:
+    sequence_view()
+      : m_data(0)
+      , m_length(0)
+      , m_size(0)
+      , m_stride(0)
+      , m_table(0)
+      , m_error_code(success)
+    {
+    }
+
+    sequence_view(unsigned char const* data, ::std::size_t length, bool indexed = false)
+      : m_data(data)
+      , m_length(length)
+      , m_size(0)
+      , m_stride(0)
+      , m_table(0)
+      , m_error_code(success)
+    {
+      zero_copy_buffer reader;
+      reader.set_read(data, length);
+      uint32_t table = 0;
+      if (indexed)
+      {
+        uint32_t body = 0;
+        if (read_sidx_header(reader, m_size, m_stride, body))
+        {
+          table = sidx_entries(m_size, m_stride) * 4;
+        }
+        m_table = (uint32_t)reader.read_length();
+      }
+      else
+      {
+        read(reader, m_size);
+      }
+      if (!reader.error())
+      {
+        check_read_length(reader, m_size, min_size_of<value_type>());
+      }
+      if (reader.error())
+      {
+        m_size = 0;
+        m_stride = 0;
+        m_error_code = reader.error_code();
+        return;
+      }
+      // first element is after offset table if any.
+      m_offsets.push_back((uint32_t)reader.read_length() + table);
+    }
+
+    AMSG_INLINE ::std::size_t size() const
+    {
+      return m_size;
+    }
+
+    AMSG_INLINE bool empty() const
+    {
+      return m_size == 0;
+    }
+
+    AMSG_INLINE bool indexed() const
+    {
+      return m_stride > 0;
+    }
+
+    AMSG_INLINE error_code_t error_code() const
+    {
+      return m_error_code;
+    }
+
+    AMSG_INLINE bool error() const
+    {
+      return m_error_code != success;
+    }
+
+    /// empty view if out of range or sequence is broken.
+    view<value_type> operator[](::std::size_t i) const
+    {
+      if (i >= m_size)
+      {
+        return view<value_type>();
+      }
+      if (m_stride > 0)
+      {
+        uint32_t entry = 0;
+        ::std::memcpy(&entry, m_data + m_table + (i / m_stride) * 4, 4);
+        uint64_t first = (uint64_t)m_offsets[0] + le_to_host(entry);
+        uint32_t begin = first < m_length ? (uint32_t)first : (uint32_t)m_length;
+        uint32_t end = 0;
+        for (::std::size_t n = i % m_stride; n > 0; --n)
+        {
+          if (!element_end(begin, end))
+          {
+            return view<value_type>();
+          }
+          begin = end;
+        }
+        if (!element_end(begin, end))
+        {
+          return view<value_type>();
+        }
+        return view<value_type>(m_data + begin, end - begin);
+      }
+      while (m_offsets.size() <= i + 1)
+      {
+        uint32_t end = 0;
+        if (!element_end(m_offsets.back(), end))
+        {
+          return view<value_type>();
+        }
+        m_offsets.push_back(end);
+      }
+      return view<value_type>(m_data + m_offsets[i], m_offsets[i + 1] - m_offsets[i]);
+    }
+
+  private:
+    /// end of element at begin by its length prefix.
+    bool element_end(uint32_t begin, uint32_t& end) const
+    {
+      if (m_error_code != success)
+      {
+        return false;
+      }
+      zero_copy_buffer reader;
+      uint32_t len_tag = 0;
+      if (begin > m_length)
+      {
+        reader.set_error_code(stream_buffer_overflow);
+      }
+      else
+      {
+        reader.set_read(m_data + begin, m_length - begin);
+        read(reader, len_tag);
+      }
+      if (!reader.error() && (len_tag == 0 || len_tag > m_length - begin))
+      {
+        reader.set_error_code(stream_buffer_overflow);
+      }
+      if (reader.error())
+      {
+        m_error_code = reader.error_code();
+        return false;
+      }
+      end = begin + len_tag;
+      return true;
+    }
+
+    unsigned char const* m_data;
+    ::std::size_t m_length;
+    uint32_t m_size;
+    uint32_t m_stride;
+    uint32_t m_table;
+    mutable error_code_t m_error_code;
+    mutable ::std::vector<uint32_t> m_offsets;
+  };
+
+  /// view the AMSG struct at stream's read position and move past it, decoding nothing.
+  template<typename value_type>
+  AMSG_INLINE view<value_type> make_view(zero_copy_buffer& stream)
+  {
+    unsigned char const* data = stream.read_ptr();
+    zero_copy_buffer reader;
+    reader.set_read(data, stream.read_remain());
+    uint32_t len_tag = 0;
+    read(reader, len_tag);
+    if (reader.error() || len_tag > stream.read_remain())
+    {
+      stream.set_error_code(stream_buffer_overflow);
+      return view<value_type>();
+    }
+    stream.skip_read(len_tag);
+    return view<value_type>(data, len_tag);
+  }
+
 }
 
 #endif